@@ -23,15 +23,24 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 } ubo;
 
 layout(push_constant) uniform Push {
-    mat4 modelMatrix;
+    mat4 modelMatrix;// includes the dequantization of packed positions
+    mat3 normalMatrix;
+    uint octahedralNormals;
 } push;
 
+vec3 octahedralDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
     vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
-    // only works for uniform scale
-    fragNormalWorld = normalize(mat3(push.modelMatrix) * normal);
+    vec3 localNormal = push.octahedralNormals != 0u ? octahedralDecode(normal.xy) : normal;
+    fragNormalWorld = normalize(push.normalMatrix * localNormal);
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
 }
@@ -1,11 +1,15 @@
 #include "first_app.h"
 #include "fmt/core.h"
 #include "lve_camera.h"
+#include "lve_file_watcher.h"
 #include "movement_controller.h"
+#include "rendering/lve_deletion_queue.h"
 #include "rendering/systems/point_light_system.h"
 #include "rendering/systems/simple_render_system.h"
+#include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstring>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
@@ -14,58 +18,72 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
-#include "rendering/lve_buffer.h"
+#include "rendering/lve_frame_allocator.h"
 #include <glm/glm.hpp>
 
 namespace lve {
 
+namespace {
+// frame time percentiles in milliseconds, frameTimes is reordered
+void printFrameTimes(const char* label, std::vector<float>& frameTimes) {
+  auto percentile = [&](float p) {
+    auto n = static_cast<size_t>(p * static_cast<float>(frameTimes.size() - 1));
+    std::nth_element(frameTimes.begin(), frameTimes.begin() + n, frameTimes.end());
+    return frameTimes[n] * 1000.f;
+  };
+  fmt::println("{}: {} frames, p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms", label,
+               frameTimes.size(), percentile(.5f), percentile(.99f), percentile(1.f));
+}
+} // namespace
+
 FirstApp::FirstApp() {
   globalPool =
       LveDescriptorPool::Builder(lveDevice)
-          .setMaxSets(LveSwapchain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapchain::MAX_FRAMES_IN_FLIGHT)
+          .setMaxSets(1)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1)
           .build();
   loadGameObjects();
+  lveDevice.allocator().printStats();
+  lveDevice.printMemoryBudget();
 }
 
 FirstApp::~FirstApp() = default;
 
 void FirstApp::run() {
-  std::vector<std::unique_ptr<LveBuffer>> uboBuffers(LveSwapchain::MAX_FRAMES_IN_FLIGHT);
-
-  for (auto& uboBuffer : uboBuffers) {
-    uboBuffer = std::make_unique<LveBuffer>(
-        lveDevice, sizeof(GlobalUbo), 1, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-        lveDevice.properties.limits.minUniformBufferOffsetAlignment);
-    uboBuffer->map();
-  }
+  LveFrameAllocator frameAllocator{lveDevice, LveSwapchain::MAX_FRAMES_IN_FLIGHT};
 
   auto globalSetLayout = LveDescriptorSetLayout::Builder(lveDevice)
-                             .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                             .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
                              .build();
 
-  std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapchain::MAX_FRAMES_IN_FLIGHT);
-  for (int i = 0; i < globalDescriptorSets.size(); i++) {
-    auto bufferInfo = uboBuffers[i]->descriptorInfo();
-    LveDescriptorWriter(*globalSetLayout, *globalPool)
-        .writeBuffer(0, &bufferInfo)
-        .build(globalDescriptorSets[i]);
-  }
+  // a single set serves every frame, the dynamic offset picks the frame's GlobalUbo
+  VkDescriptorSet globalDescriptorSet;
+  auto bufferInfo = frameAllocator.descriptorInfo(sizeof(GlobalUbo));
+  LveDescriptorWriter(*globalSetLayout, *globalPool)
+      .writeBuffer(0, &bufferInfo)
+      .build(globalDescriptorSet);
 
-  SimpleRenderSystem simpleRenderSystem{lveDevice, lveRenderer.getSwapchainRenderPass(),
+  SimpleRenderSystem simpleRenderSystem{lveDevice, threadPool,
+                                        lveRenderer.getSwapchainRenderPass(),
                                         globalSetLayout->getDescriptorSetLayout()};
 
-  PointLightSystem pointLightSystem{lveDevice, lveRenderer.getSwapchainRenderPass(),
+  PointLightSystem pointLightSystem{lveDevice, threadPool, lveRenderer.getSwapchainRenderPass(),
                                     globalSetLayout->getDescriptorSetLayout()};
   LveCamera camera{};
 
-  auto viewerObject = LveGameObject::createGameObject();
-  viewerObject.transform.translation.z = -1.0f;
+  TransformComponent viewerTransform{};
+  viewerTransform.translation.z = -1.0f;
   MovementController cameraController{lveWindow.getGLFWwindow()};
 
+  // changed assets and shaders are reloaded while the app keeps running
+  LveFileWatcher fileWatcher{};
+  fileWatcher.watchDirectory("./assets");
+  fileWatcher.watchDirectory("./shaders");
+
   auto currentTime = std::chrono::high_resolution_clock::now();
+  // reported once every requested or reloaded model has finished uploading
+  std::vector<float> streamingFrameTimes{};
 
   while (!lveWindow.shouldClose()) {
     glfwPollEvents();
@@ -76,26 +94,55 @@ void FirstApp::run() {
 
     currentTime = newTime;
 
-    cameraController.handleMouseMovement(lveWindow.getGLFWwindow(), frameTime, viewerObject);
-    camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
-    cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerObject);
+    if (modelRegistry.isStreaming()) {
+      streamingFrameTimes.push_back(frameTime);
+    } else if (!streamingFrameTimes.empty()) {
+      printFrameTimes("frame times while streaming", streamingFrameTimes);
+      streamingFrameTimes.clear();
+    }
+
+    cameraController.handleMouseMovement(lveWindow.getGLFWwindow(), frameTime, viewerTransform);
+    camera.setViewYXZ(viewerTransform.translation, viewerTransform.rotation);
+    cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerTransform);
 
     float aspect = lveRenderer.getAspectRatio();
 
     camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
 
     if (auto commandBuffer = lveRenderer.beginFrame()) {
+      lveDevice.beginFrame();
+      for (const auto& filepath : fileWatcher.poll()) {
+        modelRegistry.reload(filepath);
+        simpleRenderSystem.reloadShader(filepath, lveRenderer.getSwapchainRenderPass());
+        pointLightSystem.reloadShader(filepath, lveRenderer.getSwapchainRenderPass());
+      }
+      modelRegistry.beginFrame();
+      scene.beginFrame();
       int frameIndex = lveRenderer.getFrameIndex();
-      FrameInfo frameInfo{
-          frameIndex, frameTime, commandBuffer, camera, globalDescriptorSets[frameIndex],
-          gameObjects};
+      frameAllocator.beginFrame(frameIndex);
+
       // update
       GlobalUbo ubo{};
       ubo.projection = camera.getProjection();
       ubo.view = camera.getView();
-      pointLightSystem.update(frameInfo, ubo);
-      uboBuffers[frameIndex]->writeToBuffer(&ubo);
-      uboBuffers[frameIndex]->flush();
+      LveFrameSlice uboSlice = frameAllocator.allocate(sizeof(GlobalUbo));
+      FrameInfo frameInfo{frameIndex,
+                          frameTime,
+                          commandBuffer,
+                          camera,
+                          lveRenderer.getExtent(),
+                          globalDescriptorSet,
+                          uboSlice.dynamicOffset,
+                          frameAllocator,
+                          scene};
+      pointLightSystem.update(frameInfo);
+      scene.updateTransforms();
+      pointLightSystem.writeLights(frameInfo, ubo);
+      std::memcpy(uboSlice.data, &ubo, sizeof(GlobalUbo));
+      frameAllocator.flush();
+
+      // culling dispatches can't be recorded inside the render pass
+      simpleRenderSystem.cullGameObjects(frameInfo);
 
       // render
       lveRenderer.beginSwapchainRenderPass(commandBuffer);
@@ -109,32 +156,31 @@ void FirstApp::run() {
     }
   }
 
-  vkDeviceWaitIdle(lveDevice.device());
+  lveDevice.waitIdle();
 }
 
 void FirstApp::loadGameObjects() {
-  std::shared_ptr<LveModel> lveModel =
-      LveModel::createModelFromFile(lveDevice, "./assets/smooth_vase.obj");
-
-  std::shared_ptr<LveModel> floor = LveModel::createModelFromFile(lveDevice, "./assets/quad.obj");
-
-  auto floorObj = LveGameObject::createGameObject();
-  floorObj.model = floor;
-  floorObj.transform.translation = {.5, .0f, 0.0f};
-  floorObj.transform.scale = {1.5f, 1.5f, 1.5f};
-  gameObjects.emplace(floorObj.getId(), std::move(floorObj));
-
-  auto cube = LveGameObject::createGameObject();
-  cube.model = lveModel;
-  cube.transform.translation = {.0, .0f, 0.0f};
-  cube.transform.scale = {1.5f, 1.5f, 1.5f};
-  gameObjects.emplace(cube.getId(), std::move(cube));
-
-  auto cube2 = LveGameObject::createGameObject();
-  cube2.model = lveModel;
-  cube2.transform.translation = {1.0, .0f, 0.0f};
-  cube2.transform.scale = {1.5f, 1.5f, 1.5f};
-  gameObjects.emplace(cube2.getId(), std::move(cube2));
+  std::shared_ptr<LveModel> floor = modelRegistry.get("./assets/quad.obj");
+  // the vases stream in while the first frames are already rendered
+  auto vase = modelRegistry.request("./assets/smooth_vase.obj");
+
+  auto floorObj = scene.createGameObject();
+  scene.emplace<ModelComponent>(floorObj, floor);
+  auto& floorTransform = scene.editTransform(floorObj);
+  floorTransform.translation = {.5, .0f, 0.0f};
+  floorTransform.scale = {1.5f, 1.5f, 1.5f};
+
+  auto cube = scene.createGameObject();
+  scene.emplace<ModelComponent>(cube, nullptr, vase);
+  auto& cubeTransform = scene.editTransform(cube);
+  cubeTransform.translation = {.0, .0f, 0.0f};
+  cubeTransform.scale = {1.5f, 1.5f, 1.5f};
+
+  auto cube2 = scene.createGameObject();
+  scene.emplace<ModelComponent>(cube2, nullptr, vase);
+  auto& cube2Transform = scene.editTransform(cube2);
+  cube2Transform.translation = {1.0, .0f, 0.0f};
+  cube2Transform.scale = {1.5f, 1.5f, 1.5f};
 
   std::vector<glm::vec3> lightColors{
       {1.f, .1f, .1f}, {.1f, .1f, 1.f}, {.1f, 1.f, .1f},
@@ -142,12 +188,11 @@ void FirstApp::loadGameObjects() {
   };
 
   for (int i = 0; i < lightColors.size(); i++) {
-    auto pointLight = LveGameObject::makePointLight(0.2f);
-    pointLight.color = lightColors[i];
+    auto pointLight = scene.makePointLight(0.2f, 0.1f, lightColors[i]);
     auto rotateLight = glm::rotate(glm::mat4(1.f), (i * glm::two_pi<float>()) / lightColors.size(),
                                    {0.f, -1.f, 0.f});
-    pointLight.transform.translation = glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
-    gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+    scene.editTransform(pointLight).translation =
+        glm::vec3(rotateLight * glm::vec4(-1.f, -1.f, -1.f, 1.f));
   }
 }
 } // namespace lve
@@ -1,6 +1,8 @@
 #pragma once
 
-#include "lve_game_object.h"
+#include "lve_model_registry.h"
+#include "lve_scene.h"
+#include "lve_thread_pool.h"
 #include "rendering/lve_descriptors.h"
 #include "rendering/lve_renderer.h"
 #include "rendering/lve_window.h"
@@ -28,9 +30,11 @@ private:
   LveWindow lveWindow{WIDTH, HEIGHT, "engine"};
   LveDevice lveDevice{lveWindow};
   LveRenderer lveRenderer{lveWindow, lveDevice};
+  LveThreadPool threadPool{};
+  LveModelRegistry modelRegistry{lveDevice, threadPool};
 
   // order matters
   std::unique_ptr<LveDescriptorPool> globalPool{};
-  LveGameObject::Map gameObjects{};
+  LveScene scene{};
 };
 } // namespace lve
@@ -0,0 +1,95 @@
+#pragma once
+
+// std
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Sparse set of components of one type, keyed by game object index.
+ *
+ * Components are kept packed in a dense array and are iterated in that order, ids() lists the
+ * owning game object of every component at the same index. A sparse array indexed by id maps ids
+ * to dense indices, so lookups by id are a single array access. Ids are the indices of
+ * LveGameObject handles, whether a handle is still alive is up to the LveScene to tell.
+ *
+ * Removing a component moves the last one into its place, iteration order isn't stable and
+ * references to components are invalidated by emplace and remove.
+ */
+template <typename T>
+class LveComponentPool {
+public:
+  using id_t = uint32_t;
+
+  template <typename... Args>
+  T& emplace(id_t id, Args&&... args) {
+    assert(!contains(id) && "Game object already has a component of this type");
+    if (id >= sparse.size()) {
+      sparse.resize(static_cast<size_t>(id) + 1, INVALID_INDEX);
+    }
+    sparse[id] = static_cast<uint32_t>(dense.size());
+    dense.push_back(id);
+    return components_.emplace_back(T{std::forward<Args>(args)...});
+  }
+
+  void remove(id_t id) {
+    if (!contains(id)) {
+      return;
+    }
+
+    uint32_t index = sparse[id];
+    id_t last = dense.back();
+    dense[index] = last;
+    components_[index] = std::move(components_.back());
+    sparse[last] = index;
+
+    dense.pop_back();
+    components_.pop_back();
+    sparse[id] = INVALID_INDEX;
+  }
+
+  void clear() {
+    sparse.clear();
+    dense.clear();
+    components_.clear();
+  }
+
+  [[nodiscard]] bool contains(id_t id) const {
+    return id < sparse.size() && sparse[id] != INVALID_INDEX;
+  }
+
+  T& get(id_t id) {
+    assert(contains(id) && "Game object has no component of this type");
+    return components_[sparse[id]];
+  }
+  const T& get(id_t id) const {
+    assert(contains(id) && "Game object has no component of this type");
+    return components_[sparse[id]];
+  }
+
+  // nullptr if the game object has no component of this type
+  T* find(id_t id) { return contains(id) ? &components_[sparse[id]] : nullptr; }
+  const T* find(id_t id) const { return contains(id) ? &components_[sparse[id]] : nullptr; }
+
+  [[nodiscard]] size_t size() const { return dense.size(); }
+  [[nodiscard]] bool empty() const { return dense.empty(); }
+
+  // owner of the component at the same index of components()
+  [[nodiscard]] const std::vector<id_t>& ids() const { return dense; }
+  std::vector<T>& components() { return components_; }
+  [[nodiscard]] const std::vector<T>& components() const { return components_; }
+
+private:
+  static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+  std::vector<uint32_t> sparse{};
+  std::vector<id_t> dense{};
+  std::vector<T> components_{};
+};
+
+} // namespace lve
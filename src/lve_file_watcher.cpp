@@ -0,0 +1,139 @@
+#include "lve_file_watcher.h"
+
+// std
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+namespace {
+std::string normalize(const std::filesystem::path& path) {
+  return path.lexically_normal().generic_string();
+}
+} // namespace
+
+LveFileWatcher::LveFileWatcher() {
+#ifdef __linux__
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotifyFd < 0) {
+    throw std::runtime_error("failed to initialize inotify!");
+  }
+#endif
+}
+
+LveFileWatcher::~LveFileWatcher() {
+#ifdef __linux__
+  close(inotifyFd);
+#endif
+}
+
+/**
+ * @return false if the directory doesn't exist or can't be watched
+ */
+bool LveFileWatcher::watchDirectory(const std::string& directory) {
+  std::error_code error;
+  if (!std::filesystem::is_directory(directory, error)) {
+    return false;
+  }
+
+#ifdef __linux__
+  int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (watch < 0) {
+    return false;
+  }
+  directories[watch] = directory;
+#else
+  directories[static_cast<int>(directories.size())] = directory;
+  // files that exist now are only reported once they change
+  for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+    if (file.is_regular_file(error)) {
+      modificationTimes[normalize(file.path())] = file.last_write_time(error);
+    }
+  }
+#endif
+  return true;
+}
+
+std::vector<std::string> LveFileWatcher::poll() {
+#ifdef __linux__
+  std::vector<std::string> changed = readEvents();
+#else
+  std::vector<std::string> changed = pollModificationTimes();
+#endif
+
+  auto now = std::chrono::steady_clock::now();
+  for (auto& path : changed) {
+    settling[path] = now;
+  }
+
+  std::vector<std::string> settled{};
+  for (auto it = settling.begin(); it != settling.end();) {
+    if (now - it->second >= SETTLE_TIME) {
+      settled.push_back(it->first);
+      it = settling.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return settled;
+}
+
+#ifdef __linux__
+std::vector<std::string> LveFileWatcher::readEvents() {
+  std::vector<std::string> changed{};
+  alignas(inotify_event) char buffer[4096];
+  for (;;) {
+    ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      // EAGAIN once every pending event was read
+      break;
+    }
+
+    for (ssize_t offset = 0; offset < length;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+      auto directory = directories.find(event->wd);
+      if (event->len == 0 || (event->mask & IN_ISDIR) != 0 || directory == directories.end()) {
+        continue;
+      }
+      changed.push_back(normalize(std::filesystem::path(directory->second) / event->name));
+    }
+  }
+  return changed;
+}
+#else
+std::vector<std::string> LveFileWatcher::pollModificationTimes() {
+  std::vector<std::string> changed{};
+  auto now = std::chrono::steady_clock::now();
+  if (now - lastPoll < POLL_INTERVAL) {
+    return changed;
+  }
+  lastPoll = now;
+
+  std::error_code error;
+  for (const auto& [index, directory] : directories) {
+    for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+      if (!file.is_regular_file(error)) {
+        continue;
+      }
+      auto path = normalize(file.path());
+      auto time = file.last_write_time(error);
+      auto [it, inserted] = modificationTimes.emplace(path, time);
+      if (inserted || it->second != time) {
+        it->second = time;
+        changed.push_back(path);
+      }
+    }
+  }
+  return changed;
+}
+#endif
+
+} // namespace lve
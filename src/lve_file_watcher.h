@@ -0,0 +1,60 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Reports files that were written in a set of watched directories, subdirectories aren't watched.
+ *
+ * On Linux changes come from inotify and are only reported once the writer closed the file or
+ * moved it into place, so half written files are never picked up. Other platforms compare the
+ * modification times of the files every POLL_INTERVAL.
+ *
+ * A changed file is only reported once it went SETTLE_TIME without another change, so a compiler
+ * writing a .spv in several steps or an editor saving twice triggers a single reload.
+ *
+ * poll() never blocks, it is meant to be called once per frame.
+ */
+class LveFileWatcher {
+public:
+  static constexpr std::chrono::milliseconds POLL_INTERVAL{500};
+  static constexpr std::chrono::milliseconds SETTLE_TIME{100};
+
+  LveFileWatcher();
+  ~LveFileWatcher();
+
+  LveFileWatcher(const LveFileWatcher&) = delete;
+  LveFileWatcher& operator=(const LveFileWatcher&) = delete;
+
+  bool watchDirectory(const std::string& directory);
+
+  /**
+   * @return Paths of the files that changed and then settled since the last call, each once, formed
+   * as the watched directory joined with the file name and normalized like LveModelRegistry keys
+   */
+  std::vector<std::string> poll();
+
+private:
+  // watched directory by inotify watch descriptor, or by index when polling
+  std::map<int, std::string> directories{};
+  // time of the last change of every file that hasn't settled yet
+  std::map<std::string, std::chrono::steady_clock::time_point> settling{};
+#ifdef __linux__
+  std::vector<std::string> readEvents();
+
+  int inotifyFd = -1;
+#else
+  std::vector<std::string> pollModificationTimes();
+
+  std::map<std::string, std::filesystem::file_time_type> modificationTimes{};
+  std::chrono::steady_clock::time_point lastPoll{};
+#endif
+};
+
+} // namespace lve
@@ -1,42 +1,48 @@
-
 #include "lve_game_object.h"
 
 namespace lve {
 
-glm::mat4 TransformComponent::mat4() {
+namespace {
+glm::mat3 rotationMatrix(const TransformComponent& transform) {
+  if (transform.rotationMode == TransformComponent::RotationMode::Quaternion) {
+    return glm::mat3_cast(transform.orientation);
+  }
+
+  const glm::vec3& rotation = transform.rotation;
   const float c3 = glm::cos(rotation.z);
   const float s3 = glm::sin(rotation.z);
   const float c2 = glm::cos(rotation.x);
   const float s2 = glm::sin(rotation.x);
   const float c1 = glm::cos(rotation.y);
   const float s1 = glm::sin(rotation.y);
-  return glm::mat4{{
-                       scale.x * (c1 * c3 + s1 * s2 * s3),
-                       scale.x * (c2 * s3),
-                       scale.x * (c1 * s2 * s3 - c3 * s1),
-                       0.0f,
+  return glm::mat3{{
+                       c1 * c3 + s1 * s2 * s3,
+                       c2 * s3,
+                       c1 * s2 * s3 - c3 * s1,
                    },
                    {
-                       scale.y * (c3 * s1 * s2 - c1 * s3),
-                       scale.y * (c2 * c3),
-                       scale.y * (c1 * c3 * s2 + s1 * s3),
-                       0.0f,
+                       c3 * s1 * s2 - c1 * s3,
+                       c2 * c3,
+                       c1 * c3 * s2 + s1 * s3,
                    },
                    {
-                       scale.z * (c2 * s1),
-                       scale.z * (-s2),
-                       scale.z * (c1 * c2),
-                       0.0f,
-                   },
+                       c2 * s1,
+                       -s2,
+                       c1 * c2,
+                   }};
+}
+} // namespace
+
+glm::mat4 TransformComponent::mat4() {
+  const glm::mat3 r = rotationMatrix(*this);
+  return glm::mat4{glm::vec4(r[0] * scale.x, 0.0f), glm::vec4(r[1] * scale.y, 0.0f),
+                   glm::vec4(r[2] * scale.z, 0.0f),
                    {translation.x, translation.y, translation.z, 1.0f}};
 }
-LveGameObject LveGameObject::makePointLight(float intensity, float radius, glm::vec3 color) {
-  LveGameObject gameObj = LveGameObject::createGameObject();
-  gameObj.color = color;
-  gameObj.transform.scale.x = radius;
-  gameObj.pointLightComponent = std::make_unique<PointLightComponent>();
-  gameObj.pointLightComponent->lightIntensity = intensity;
 
-  return gameObj;
+// the rotation is orthonormal, so the inverse transpose of rotation * scale is rotation / scale
+glm::mat3 TransformComponent::normalMatrix() {
+  const glm::mat3 r = rotationMatrix(*this);
+  return glm::mat3{r[0] / scale.x, r[1] / scale.y, r[2] / scale.z};
 }
 } // namespace lve
@@ -1,59 +1,99 @@
-
 #pragma once
 
 #include "glm/vec3.hpp"
 #include "lve_model.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <limits>
 #include <memory>
-#include <unordered_map>
 
 namespace lve {
 
+/*
+ * Handle of a game object in an LveScene.
+ *
+ * index addresses the game object's slot and its components, slots are reused once a game object
+ * is destroyed. generation counts how often the slot has been reused, a handle whose generation
+ * doesn't match its slot's any more is stale.
+ */
+struct LveGameObject {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool operator==(const LveGameObject& other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const LveGameObject& other) const { return !(*this == other); }
+};
+
+/*
+ * Transform of a game object relative to its parent.
+ *
+ * Inside of an LveScene the matrices are cached: translation, scale and rotation are changed
+ * through LveScene::editTransform, which marks the transform dirty, and the scene recomputes it and
+ * everything below it in the hierarchy in its next updateTransforms. The hierarchy links are
+ * managed by the scene.
+ */
 struct TransformComponent {
+  static constexpr uint32_t NO_LINK = std::numeric_limits<uint32_t>::max();
+
+  // Euler angles cost a sine and a cosine per axis every time the matrix is composed, a
+  // quaternion is turned into a matrix with multiplications only
+  enum class RotationMode { Euler, Quaternion };
+
   glm::vec3 translation{};
+  // has to be non zero on every axis for the normal matrix
   glm::vec3 scale{1.0f, 1.0f, 1.0f};
   glm::vec3 rotation{};
+  // rotation in RotationMode::Quaternion, has to be normalized
+  glm::quat orientation{1.f, 0.f, 0.f, 0.f};
+  RotationMode rotationMode = RotationMode::Euler;
 
   // Matrix corrsponds to Translate * Ry * Rx * Rz * Scale
   // Rotations correspond to Tait-bryan angles of Y(1), X(2), Z(3)
   // https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+  // or to Translate * R(orientation) * Scale in RotationMode::Quaternion
   glm::mat4 mat4();
+  // inverse transpose of mat4()'s upper 3x3, transforms normals correctly under non uniform scale
+  glm::mat3 normalMatrix();
+
+  // mat4() and normalMatrix() as of the last update
+  glm::mat4 localMatrix{1.f};
+  glm::mat3 localNormalMatrix{1.f};
+  // local matrices with the parents' matrices applied
+  glm::mat4 worldMatrix{1.f};
+  glm::mat3 worldNormalMatrix{1.f};
+
+  // game object indices of the parent, the first child and the siblings of the same parent
+  uint32_t parent = NO_LINK;
+  uint32_t firstChild = NO_LINK;
+  uint32_t previousSibling = NO_LINK;
+  uint32_t nextSibling = NO_LINK;
+  // number of parents above
+  uint32_t depth = 0;
+
+  bool localDirty = true;
+  bool worldDirty = false;
 };
 
-struct PointLightComponent {
-  float lightIntensity = 1.0f;
-};
-
-class LveGameObject {
-public:
-  using id_t = unsigned int;
-  using Map = std::unordered_map<id_t, LveGameObject>;
-
-  static LveGameObject createGameObject() {
-    static id_t currentId = 0;
-
-    return LveGameObject{currentId++};
-  }
-
-  [[nodiscard]] id_t getId() const { return id; }
-
-  static LveGameObject makePointLight(float intensity = 10.f, float radius = 0.1f,
-                                      glm::vec3 color = glm::vec3(1.f));
-
-  LveGameObject(const LveGameObject&) = delete;
-  LveGameObject& operator=(const LveGameObject&) = delete;
-  LveGameObject(LveGameObject&&) = default;
-  LveGameObject& operator=(LveGameObject&&) = default;
-
-  glm::vec3 color{};
-  TransformComponent transform{};
-
+struct ModelComponent {
   std::shared_ptr<LveModel> model{};
-  std::unique_ptr<PointLightComponent> pointLightComponent = nullptr;
-
-private:
-  explicit LveGameObject(id_t objId) : id{objId} {}
+  // a model still streaming in, model is drawn in its place (if at all) until it is resident
+  std::shared_ptr<const LveModelStream> modelStream{};
+
+  // model, replaced by the streamed model as soon as that is resident
+  LveModel* getModel() {
+    if (modelStream != nullptr && modelStream->isResident()) {
+      model = modelStream->model;
+      modelStream = nullptr;
+    }
+    return model.get();
+  }
+};
 
-  id_t id;
+// the light's radius is the x scale of its transform
+struct PointLightComponent {
+  float lightIntensity = 1.0f;
+  glm::vec3 color{1.f};
 };
 } // namespace lve
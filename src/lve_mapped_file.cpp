@@ -0,0 +1,134 @@
+#include "lve_mapped_file.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+LveMappedFile::LveMappedFile(const std::string& filepath) {
+  if (!open(filepath)) {
+    throw std::runtime_error("failed to map file: " + filepath);
+  }
+}
+
+LveMappedFile::~LveMappedFile() { close(); }
+
+LveMappedFile::LveMappedFile(LveMappedFile&& other) noexcept { *this = std::move(other); }
+
+LveMappedFile& LveMappedFile::operator=(LveMappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(opened, other.opened);
+#ifdef _WIN32
+    std::swap(fileHandle, other.fileHandle);
+    std::swap(mappingHandle, other.mappingHandle);
+#endif
+  }
+  return *this;
+}
+
+/**
+ * Maps the file at filepath, replacing any previous mapping
+ *
+ * @return false if the file doesn't exist or can't be mapped
+ */
+bool LveMappedFile::open(const std::string& filepath) {
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    return false;
+  }
+  size_ = static_cast<size_t>(fileSize.QuadPart);
+  fileHandle = file;
+  opened = true;
+  if (size_ == 0) {
+    return true;
+  }
+
+  mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mappingHandle == nullptr) {
+    close();
+    return false;
+  }
+  data_ = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  if (data_ == nullptr) {
+    close();
+    return false;
+  }
+#else
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat {};
+  if (fstat(fd, &fileStat) != 0) {
+    ::close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(fileStat.st_size);
+  opened = true;
+  if (size_ == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  // the mapping keeps its own reference to the file
+  void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    close();
+    return false;
+  }
+  data_ = mapping;
+  madvise(data_, size_, MADV_SEQUENTIAL);
+#endif
+  return true;
+}
+
+void LveMappedFile::close() {
+#ifdef _WIN32
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle != nullptr) {
+    CloseHandle(fileHandle);
+  }
+  mappingHandle = nullptr;
+  fileHandle = nullptr;
+#else
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  opened = false;
+}
+
+} // namespace lve
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lve {
+
+/*
+ * Read-only memory mapping of a whole file.
+ *
+ * The mapping stays valid for the lifetime of the object, pages are only read from disk once they
+ * are touched.
+ */
+class LveMappedFile {
+public:
+  LveMappedFile() = default;
+  explicit LveMappedFile(const std::string& filepath);
+  ~LveMappedFile();
+
+  LveMappedFile(const LveMappedFile&) = delete;
+  LveMappedFile& operator=(const LveMappedFile&) = delete;
+  LveMappedFile(LveMappedFile&& other) noexcept;
+  LveMappedFile& operator=(LveMappedFile&& other) noexcept;
+
+  bool open(const std::string& filepath);
+  void close();
+
+  [[nodiscard]] bool isOpen() const { return opened; }
+  [[nodiscard]] const char* data() const { return static_cast<const char*>(data_); }
+  [[nodiscard]] size_t size() const { return size_; }
+
+private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+  // empty files can't be mapped but still open successfully
+  bool opened = false;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#endif
+};
+
+} // namespace lve
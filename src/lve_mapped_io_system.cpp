@@ -0,0 +1,78 @@
+#include "lve_mapped_io_system.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+namespace lve {
+
+bool LveMappedIOSystem::Exists(const char* pFile) const {
+  std::error_code error{};
+  return std::filesystem::is_regular_file(pFile, error);
+}
+
+char LveMappedIOSystem::getOsSeparator() const {
+  return static_cast<char>(std::filesystem::path::preferred_separator);
+}
+
+Assimp::IOStream* LveMappedIOSystem::Open(const char* pFile, const char* pMode) {
+  // importers never write, anything but reading is refused
+  if (std::strchr(pMode, 'w') != nullptr || std::strchr(pMode, 'a') != nullptr ||
+      std::strchr(pMode, '+') != nullptr) {
+    return nullptr;
+  }
+
+  LveMappedFile file{};
+  if (!file.open(pFile)) {
+    return nullptr;
+  }
+  return new LveMappedIOStream(std::move(file));
+}
+
+void LveMappedIOSystem::Close(Assimp::IOStream* pFile) { delete pFile; }
+
+/**
+ * Copies up to pCount whole elements of pSize bytes from the current position
+ *
+ * @return Number of elements read
+ */
+size_t LveMappedIOStream::Read(void* pvBuffer, size_t pSize, size_t pCount) {
+  if (pSize == 0 || pCount == 0) {
+    return 0;
+  }
+
+  size_t count = std::min(pCount, (file.size() - position) / pSize);
+  std::memcpy(pvBuffer, file.data() + position, count * pSize);
+  position += count * pSize;
+  return count;
+}
+
+aiReturn LveMappedIOStream::Seek(size_t pOffset, aiOrigin pOrigin) {
+  size_t target;
+  switch (pOrigin) {
+  case aiOrigin_SET:
+    target = pOffset;
+    break;
+  case aiOrigin_CUR:
+    target = position + pOffset;
+    break;
+  case aiOrigin_END:
+    // the offset counts back from the end
+    if (pOffset > file.size()) {
+      return aiReturn_FAILURE;
+    }
+    target = file.size() - pOffset;
+    break;
+  default:
+    return aiReturn_FAILURE;
+  }
+
+  if (target > file.size()) {
+    return aiReturn_FAILURE;
+  }
+  position = target;
+  return aiReturn_SUCCESS;
+}
+
+} // namespace lve
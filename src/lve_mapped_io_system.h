@@ -0,0 +1,44 @@
+#pragma once
+
+#include "lve_mapped_file.h"
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+// std
+#include <utility>
+
+namespace lve {
+
+/*
+ * Assimp file system that reads through memory mappings instead of buffered stdio.
+ *
+ * Assimp's default streams copy every file through the C runtime's buffers, and most importers
+ * then read the whole file into a buffer of their own. Reads from a mapped stream copy straight
+ * out of the page cache instead. Only reading is supported.
+ */
+class LveMappedIOSystem : public Assimp::IOSystem {
+public:
+  bool Exists(const char* pFile) const override;
+  char getOsSeparator() const override;
+  Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override;
+  void Close(Assimp::IOStream* pFile) override;
+};
+
+class LveMappedIOStream : public Assimp::IOStream {
+public:
+  explicit LveMappedIOStream(LveMappedFile file) : file{std::move(file)} {}
+
+  size_t Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+  // read only
+  size_t Write(const void*, size_t, size_t) override { return 0; }
+  aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+  size_t Tell() const override { return position; }
+  size_t FileSize() const override { return file.size(); }
+  void Flush() override {}
+
+private:
+  LveMappedFile file;
+  size_t position = 0;
+};
+
+} // namespace lve
@@ -0,0 +1,229 @@
+#include "lve_mesh_file.h"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace lve {
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Reads the size and modification time of a source asset. Only the metadata is compared, hashing
+ * the content would read every source on each load. The asset copy of the build only replaces
+ * changed files, so unchanged assets keep their modification time
+ *
+ * @return false if the source doesn't exist
+ */
+bool LveMeshFile::statSource(const std::string& sourcePath, uint64_t& size,
+                             int64_t& modifiedTime) {
+  std::error_code error{};
+  auto fileSize = std::filesystem::file_size(sourcePath, error);
+  if (error) {
+    return false;
+  }
+  auto fileTime = std::filesystem::last_write_time(sourcePath, error);
+  if (error) {
+    return false;
+  }
+
+  size = fileSize;
+  // in the clock's own epoch, the cooker and the engine are built with the same standard library
+  modifiedTime = static_cast<int64_t>(fileTime.time_since_epoch().count());
+  return true;
+}
+
+void LveMeshFile::write(const std::string& cookedPath, const LveModel::Builder& builder,
+                        uint64_t sourceSize, int64_t sourceModifiedTime) {
+  LveMeshFileHeader header{};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.vertexSize = sizeof(LveModel::Vertex);
+  header.submeshSize = sizeof(LveModel::Submesh);
+  header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+  header.indexCount = static_cast<uint32_t>(builder.indices.size());
+  header.submeshCount = static_cast<uint32_t>(builder.submeshes.size());
+  header.lodCount = static_cast<uint32_t>(builder.lods.size());
+  header.meshletCount = static_cast<uint32_t>(builder.meshlets.size());
+  header.sourceSize = sourceSize;
+  header.sourceModifiedTime = sourceModifiedTime;
+  for (int i = 0; i < 3; i++) {
+    header.boundsMin[i] = builder.boundsMin[i];
+    header.boundsMax[i] = builder.boundsMax[i];
+    header.positionOffset[i] = builder.positionOffset[i];
+    header.positionScale[i] = builder.positionScale[i];
+  }
+  if (builder.packedPositions.size() != builder.vertices.size()) {
+    throw std::runtime_error("cooked meshes need packed vertices: " + cookedPath);
+  }
+
+  uint64_t vertexBytes = header.vertexCount * sizeof(LveModel::Vertex);
+  uint64_t indexBytes = header.indexCount * sizeof(uint32_t);
+  uint64_t submeshBytes = header.submeshCount * sizeof(LveModel::Submesh);
+  uint64_t lodBytes = header.lodCount * sizeof(LveModel::Lod);
+  uint64_t meshletBytes = header.meshletCount * sizeof(LveModel::Meshlet);
+  uint64_t packedPositionBytes = header.vertexCount * sizeof(LveModel::PackedVertex::Position);
+  uint64_t packedAttributeBytes =
+      header.vertexCount * sizeof(LveModel::PackedVertex::Attributes);
+  header.vertexOffset = alignUp(sizeof(LveMeshFileHeader), 16);
+  header.indexOffset = alignUp(header.vertexOffset + vertexBytes, 16);
+  header.submeshOffset = alignUp(header.indexOffset + indexBytes, 16);
+  header.lodOffset = alignUp(header.submeshOffset + submeshBytes, 16);
+  header.meshletOffset = alignUp(header.lodOffset + lodBytes, 16);
+  header.packedPositionOffset = alignUp(header.meshletOffset + meshletBytes, 16);
+  header.packedAttributeOffset = alignUp(header.packedPositionOffset + packedPositionBytes, 16);
+
+  std::vector<char> contents(header.packedAttributeOffset + packedAttributeBytes, 0);
+  std::memcpy(contents.data(), &header, sizeof(header));
+  std::memcpy(contents.data() + header.vertexOffset, builder.vertices.data(), vertexBytes);
+  std::memcpy(contents.data() + header.indexOffset, builder.indices.data(), indexBytes);
+  std::memcpy(contents.data() + header.submeshOffset, builder.submeshes.data(), submeshBytes);
+  std::memcpy(contents.data() + header.lodOffset, builder.lods.data(), lodBytes);
+  std::memcpy(contents.data() + header.meshletOffset, builder.meshlets.data(), meshletBytes);
+  std::memcpy(contents.data() + header.packedPositionOffset, builder.packedPositions.data(),
+              packedPositionBytes);
+  std::memcpy(contents.data() + header.packedAttributeOffset, builder.packedAttributes.data(),
+              packedAttributeBytes);
+
+  std::ofstream file{cookedPath, std::ios::binary | std::ios::trunc};
+  if (!file.is_open() ||
+      !file.write(contents.data(), static_cast<std::streamsize>(contents.size()))) {
+    throw std::runtime_error("failed to write cooked mesh: " + cookedPath);
+  }
+}
+
+/**
+ * Maps a cooked mesh
+ *
+ * @param sourcePath Asset the mesh was cooked from. If it exists, the cooked mesh is only used
+ * when the asset's size and modification time still match the ones it was cooked from
+ *
+ * @return false if the cooked mesh is missing, corrupt, cooked by a different engine version or
+ * stale
+ */
+bool LveMeshFile::open(const std::string& cookedPath, const std::string& sourcePath) {
+  if (!file.open(cookedPath) || !isValid()) {
+    file.close();
+    return false;
+  }
+
+  uint64_t sourceSize = 0;
+  int64_t sourceModifiedTime = 0;
+  if (statSource(sourcePath, sourceSize, sourceModifiedTime) &&
+      (sourceSize != header().sourceSize ||
+       sourceModifiedTime != header().sourceModifiedTime)) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+LveModel::MeshData LveMeshFile::data() const {
+  const auto& h = header();
+
+  LveModel::MeshData data{};
+  data.vertices = reinterpret_cast<const LveModel::Vertex*>(file.data() + h.vertexOffset);
+  data.vertexCount = h.vertexCount;
+  data.indices = reinterpret_cast<const uint32_t*>(file.data() + h.indexOffset);
+  data.indexCount = h.indexCount;
+  data.submeshes = reinterpret_cast<const LveModel::Submesh*>(file.data() + h.submeshOffset);
+  data.submeshCount = h.submeshCount;
+  data.lods = reinterpret_cast<const LveModel::Lod*>(file.data() + h.lodOffset);
+  data.lodCount = h.lodCount;
+  data.meshlets = reinterpret_cast<const LveModel::Meshlet*>(file.data() + h.meshletOffset);
+  data.meshletCount = h.meshletCount;
+  data.boundsMin = {h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]};
+  data.boundsMax = {h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]};
+  data.packedPositions = reinterpret_cast<const LveModel::PackedVertex::Position*>(
+      file.data() + h.packedPositionOffset);
+  data.packedAttributes = reinterpret_cast<const LveModel::PackedVertex::Attributes*>(
+      file.data() + h.packedAttributeOffset);
+  data.positionOffset = {h.positionOffset[0], h.positionOffset[1], h.positionOffset[2]};
+  data.positionScale = {h.positionScale[0], h.positionScale[1], h.positionScale[2]};
+  return data;
+}
+
+bool LveMeshFile::isValid() const {
+  if (file.size() < sizeof(LveMeshFileHeader)) {
+    return false;
+  }
+
+  const auto& h = header();
+  // models are never empty, see Builder::loadModel
+  if (h.magic != MAGIC || h.version != VERSION || h.vertexSize != sizeof(LveModel::Vertex) ||
+      h.submeshSize != sizeof(LveModel::Submesh) || h.vertexCount == 0) {
+    return false;
+  }
+
+  if (h.vertexOffset + uint64_t{h.vertexCount} * sizeof(LveModel::Vertex) > file.size() ||
+      h.indexOffset + uint64_t{h.indexCount} * sizeof(uint32_t) > file.size() ||
+      h.submeshOffset + uint64_t{h.submeshCount} * sizeof(LveModel::Submesh) > file.size() ||
+      h.lodOffset + uint64_t{h.lodCount} * sizeof(LveModel::Lod) > file.size() ||
+      h.meshletOffset + uint64_t{h.meshletCount} * sizeof(LveModel::Meshlet) > file.size() ||
+      h.packedPositionOffset +
+              uint64_t{h.vertexCount} * sizeof(LveModel::PackedVertex::Position) >
+          file.size() ||
+      h.packedAttributeOffset +
+              uint64_t{h.vertexCount} * sizeof(LveModel::PackedVertex::Attributes) >
+          file.size()) {
+    return false;
+  }
+  return hasValidRanges();
+}
+
+/**
+ * Checks that every submesh, lod and meshlet range lies within the file's arrays and that every
+ * index stays within the vertices once its submesh's vertexOffset is added, a corrupt index would
+ * otherwise read past the model's vertices on the GPU
+ */
+bool LveMeshFile::hasValidRanges() const {
+  auto data = this->data();
+
+  auto isValidIndexRange = [&](uint32_t firstIndex, uint32_t indexCount, int64_t vertexOffset) {
+    if (uint64_t{firstIndex} + indexCount > data.indexCount || vertexOffset < 0) {
+      return false;
+    }
+    for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++) {
+      if (vertexOffset + data.indices[i] >= data.vertexCount) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (data.submeshCount == 0) {
+    return data.lodCount == 0 && isValidIndexRange(0, data.indexCount, 0);
+  }
+
+  for (uint32_t i = 0; i < data.submeshCount; i++) {
+    const auto& submesh = data.submeshes[i];
+    if (int64_t{submesh.vertexOffset} + submesh.vertexCount > data.vertexCount ||
+        uint64_t{submesh.firstMeshlet} + submesh.meshletCount > data.meshletCount) {
+      return false;
+    }
+    if (data.indexCount > 0 &&
+        !isValidIndexRange(submesh.firstIndex, submesh.indexCount, submesh.vertexOffset)) {
+      return false;
+    }
+    for (uint32_t m = submesh.firstMeshlet; m < submesh.firstMeshlet + submesh.meshletCount; m++) {
+      const auto& meshlet = data.meshlets[m];
+      if (uint64_t{meshlet.firstIndex} + meshlet.indexCount > submesh.indexCount) {
+        return false;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < data.lodCount; i++) {
+    if (uint64_t{data.lods[i].firstSubmesh} + data.lods[i].submeshCount > data.submeshCount) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace lve
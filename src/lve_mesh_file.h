@@ -0,0 +1,93 @@
+#pragma once
+
+#include "lve_mapped_file.h"
+#include "lve_model.h"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+// Layout of a .lvemesh file: header, vertices, indices, submeshes, lods, meshlets, packed
+// positions, packed attributes. Every section starts at a 16 byte aligned offset and holds the raw
+// in-memory representation of its elements
+struct LveMeshFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  // sizes of the structs the file was cooked with, a layout change makes the file stale
+  uint32_t vertexSize;
+  uint32_t submeshSize;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t submeshCount;
+  uint32_t lodCount;
+  uint32_t meshletCount;
+  uint32_t reserved;
+  // size and modification time of the source asset the file was cooked from
+  uint64_t sourceSize;
+  int64_t sourceModifiedTime;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t submeshOffset;
+  uint64_t lodOffset;
+  uint64_t meshletOffset;
+  // the PackedVertex streams, one element per vertex
+  uint64_t packedPositionOffset;
+  uint64_t packedAttributeOffset;
+  float boundsMin[3];
+  float boundsMax[3];
+  // dequantization of the packed positions
+  float positionOffset[3];
+  float positionScale[3];
+};
+
+/*
+ * Cooked mesh, the Builder output of an asset stored so it can be loaded without parsing.
+ *
+ * Opening a file only maps it and validates the header, data() points straight into the mapping.
+ */
+class LveMeshFile {
+public:
+  static constexpr uint32_t MAGIC = 0x4d45564c; // "LVEM"
+  static constexpr uint32_t VERSION = 6;
+
+  static std::string cookedPathFor(const std::string& sourcePath) {
+    return sourcePath + ".lvemesh";
+  }
+
+  static bool statSource(const std::string& sourcePath, uint64_t& size, int64_t& modifiedTime);
+  static void write(const std::string& cookedPath, const LveModel::Builder& builder,
+                    uint64_t sourceSize, int64_t sourceModifiedTime);
+
+  bool open(const std::string& cookedPath, const std::string& sourcePath);
+
+  [[nodiscard]] const LveMeshFileHeader& header() const {
+    return *reinterpret_cast<const LveMeshFileHeader*>(file.data());
+  }
+  [[nodiscard]] LveModel::MeshData data() const;
+
+private:
+  bool isValid() const;
+  bool hasValidRanges() const;
+
+  LveMappedFile file{};
+};
+
+// Mesh data of one file, mapped from its cooked mesh or imported through Assimp if that is
+// missing or stale
+struct LveMeshSource {
+  LveMeshFile cooked{};
+  LveModel::Builder builder{};
+  bool isCooked = false;
+
+  // runs on worker threads, every call uses its own importer
+  static std::unique_ptr<LveMeshSource> load(const std::string& filepath);
+
+  [[nodiscard]] LveModel::MeshData data() const {
+    return isCooked ? cooked.data() : builder.data();
+  }
+};
+
+} // namespace lve
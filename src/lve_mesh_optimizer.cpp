@@ -0,0 +1,448 @@
+#include "lve_mesh_optimizer.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+struct VertexBytesHash {
+  size_t operator()(const LveModel::Vertex& vertex) const {
+    // FNV-1a over the raw bytes, duplicates are bitwise identical
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < sizeof(vertex); i++) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct VertexBytesEqual {
+  bool operator()(const LveModel::Vertex& a, const LveModel::Vertex& b) const {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+};
+
+// Forsyth's vertex score: recently used vertices and vertices with few triangles left win
+float vertexScore(int32_t cachePosition, uint32_t liveTriangles) {
+  if (liveTriangles == 0) {
+    return -1.f;
+  }
+
+  float score = 0.f;
+  if (cachePosition >= 0) {
+    // the triangle just emitted gets a fixed score so its vertices aren't favoured too much
+    if (cachePosition < 3) {
+      score = 0.75f;
+    } else {
+      constexpr float scale = 1.f / (LveMeshOptimizer::OPTIMIZE_CACHE_SIZE - 3);
+      score = std::pow(1.f - static_cast<float>(cachePosition - 3) * scale, 1.5f);
+    }
+  }
+  return score + 2.f / std::sqrt(static_cast<float>(liveTriangles));
+}
+
+// misses of a FIFO cache, restarting with an empty cache
+uint32_t simulateMisses(const uint32_t* indices, size_t indexCount, std::vector<uint32_t>& stamps,
+                        uint32_t& time, uint32_t cacheSize) {
+  uint32_t misses = 0;
+  time += cacheSize + 1;
+  for (size_t i = 0; i < indexCount; i++) {
+    uint32_t& stamp = stamps[indices[i]];
+    if (time - stamp > cacheSize) {
+      stamp = time++;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+} // namespace
+
+/**
+ * Runs all passes in the order they depend on each other
+ */
+void LveMeshOptimizer::optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  deduplicateVertices(vertices, indices);
+  optimizeVertexCache(indices, vertices.size());
+  optimizeOverdraw(indices, vertices);
+  optimizeVertexFetch(vertices, indices);
+}
+
+void LveMeshOptimizer::deduplicateVertices(std::vector<Vertex>& vertices,
+                                           std::vector<uint32_t>& indices) {
+  std::unordered_map<Vertex, uint32_t, VertexBytesHash, VertexBytesEqual> unique{};
+  unique.reserve(vertices.size());
+
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<Vertex> welded{};
+  welded.reserve(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    auto [it, inserted] = unique.emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+    if (inserted) {
+      welded.push_back(vertices[i]);
+    }
+    remap[i] = it->second;
+  }
+
+  for (auto& index : indices) {
+    index = remap[index];
+  }
+  vertices = std::move(welded);
+}
+
+/**
+ * Reorders triangles with Forsyth's linear-speed vertex cache optimization for an LRU cache of
+ * OPTIMIZE_CACHE_SIZE entries
+ */
+void LveMeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // triangles of every vertex, emitted triangles are swapped past the live ones
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (auto index : indices) {
+    liveTriangles[index]++;
+  }
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<int32_t> cachePositions(vertexCount, -1);
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+  }
+
+  std::vector<float> triangleScores(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  uint32_t best = 0;
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+    if (triangleScores[t] > triangleScores[best]) {
+      best = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<uint32_t> result{};
+  result.reserve(indices.size());
+  std::vector<uint32_t> cache{};
+  std::vector<uint32_t> nextCache{};
+  size_t scanStart = 0;
+
+  while (result.size() < indices.size()) {
+    if (best == INVALID) {
+      // nothing in the cache has triangles left, continue with the next unemitted one
+      while (emitted[scanStart]) {
+        scanStart++;
+      }
+      best = static_cast<uint32_t>(scanStart);
+    }
+
+    emitted[best] = true;
+    const uint32_t* triangle = &indices[best * 3];
+    nextCache.assign(triangle, triangle + 3);
+    for (int i = 0; i < 3; i++) {
+      uint32_t v = triangle[i];
+      result.push_back(v);
+
+      uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+      uint32_t* end = begin + liveTriangles[v];
+      auto it = std::find(begin, end, best);
+      assert(it != end && "Emitted triangle missing from adjacency");
+      std::swap(*it, *(end - 1));
+      liveTriangles[v]--;
+    }
+
+    for (auto v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        nextCache.push_back(v);
+      }
+    }
+
+    // rescore everything that moved in the cache, including the vertices that just fell out
+    for (size_t i = 0; i < nextCache.size(); i++) {
+      uint32_t v = nextCache[i];
+      cachePositions[v] = i < OPTIMIZE_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+      vertexScores[v] = vertexScore(cachePositions[v], liveTriangles[v]);
+    }
+
+    best = INVALID;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (auto v : nextCache) {
+      for (uint32_t i = 0; i < liveTriangles[v]; i++) {
+        uint32_t t = adjacency[adjacencyOffsets[v] + i];
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+
+    if (nextCache.size() > OPTIMIZE_CACHE_SIZE) {
+      nextCache.resize(OPTIMIZE_CACHE_SIZE);
+    }
+    std::swap(cache, nextCache);
+  }
+
+  indices = std::move(result);
+}
+
+/**
+ * Splits the cache optimized triangle order into clusters and draws clusters facing away from the
+ * mesh center first, following Sander et al., "Fast Triangle Reordering for Vertex Locality and
+ * Reduced Overdraw"
+ *
+ * @param threshold How much worse than the cache optimized order the ACMR of a cluster may get,
+ * higher values allow smaller clusters and better overdraw at the cost of vertex cache efficiency
+ */
+void LveMeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices,
+                                        const std::vector<Vertex>& vertices, float threshold) {
+  const size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2) {
+    return;
+  }
+
+  std::vector<uint32_t> stamps(vertices.size(), 0);
+  uint32_t time = 0;
+
+  // hard boundaries: triangles where the cache simulation misses all three vertices
+  std::vector<size_t> hardBoundaries{0};
+  time += ANALYZE_CACHE_SIZE + 1;
+  for (size_t t = 0; t < triangleCount; t++) {
+    uint32_t misses = 0;
+    for (int i = 0; i < 3; i++) {
+      uint32_t& stamp = stamps[indices[t * 3 + i]];
+      if (time - stamp > ANALYZE_CACHE_SIZE) {
+        stamp = time++;
+        misses++;
+      }
+    }
+    if (misses == 3 && t > 0) {
+      hardBoundaries.push_back(t);
+    }
+  }
+  hardBoundaries.push_back(triangleCount);
+
+  // soft boundaries: split hard clusters wherever the running ACMR is close enough to the
+  // cluster's ACMR
+  std::vector<size_t> clusters{};
+  for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+    size_t start = hardBoundaries[c];
+    size_t end = hardBoundaries[c + 1];
+    uint32_t clusterMisses =
+        simulateMisses(&indices[start * 3], (end - start) * 3, stamps, time, ANALYZE_CACHE_SIZE);
+    float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+    clusters.push_back(start);
+    time += ANALYZE_CACHE_SIZE + 1;
+    uint32_t runningMisses = 0;
+    size_t runStart = start;
+    for (size_t t = start; t < end; t++) {
+      for (int i = 0; i < 3; i++) {
+        uint32_t& stamp = stamps[indices[t * 3 + i]];
+        if (time - stamp > ANALYZE_CACHE_SIZE) {
+          stamp = time++;
+          runningMisses++;
+        }
+      }
+      size_t runLength = t + 1 - runStart;
+      if (t + 1 < end && static_cast<float>(runningMisses) <= limit * runLength) {
+        clusters.push_back(t + 1);
+        runStart = t + 1;
+        runningMisses = 0;
+        time += ANALYZE_CACHE_SIZE + 1;
+      }
+    }
+  }
+  clusters.push_back(triangleCount);
+
+  glm::vec3 meshCenter{0.f};
+  for (const auto& vertex : vertices) {
+    meshCenter += vertex.position;
+  }
+  meshCenter = meshCenter * (1.f / static_cast<float>(std::max<size_t>(vertices.size(), 1)));
+
+  // clusters are sorted by how much they face away from the center, outer surfaces come first
+  struct Cluster {
+    size_t start;
+    size_t end;
+    float sortKey;
+  };
+  std::vector<Cluster> sorted{};
+  for (size_t c = 0; c + 1 < clusters.size(); c++) {
+    glm::vec3 centroid{0.f};
+    glm::vec3 normal{0.f};
+    float area = 0.f;
+    for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      const auto& p0 = vertices[indices[t * 3]].position;
+      const auto& p1 = vertices[indices[t * 3 + 1]].position;
+      const auto& p2 = vertices[indices[t * 3 + 2]].position;
+      glm::vec3 weightedNormal = glm::cross(p1 - p0, p2 - p0);
+      float triangleArea = glm::length(weightedNormal);
+      centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+      normal += weightedNormal;
+      area += triangleArea;
+    }
+
+    float sortKey = 0.f;
+    float normalLength = glm::length(normal);
+    if (area > 0.f && normalLength > 0.f) {
+      centroid = centroid * (1.f / area);
+      sortKey = glm::dot(centroid - meshCenter, normal * (1.f / normalLength));
+    }
+    sorted.push_back({clusters[c], clusters[c + 1], sortKey});
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+  std::vector<uint32_t> result{};
+  result.reserve(indices.size());
+  for (const auto& cluster : sorted) {
+    result.insert(result.end(), indices.begin() + cluster.start * 3,
+                  indices.begin() + cluster.end * 3);
+  }
+  indices = std::move(result);
+}
+
+/**
+ * Lays out vertices in the order the index buffer first references them, unreferenced vertices
+ * are dropped
+ */
+void LveMeshOptimizer::optimizeVertexFetch(std::vector<Vertex>& vertices,
+                                           std::vector<uint32_t>& indices) {
+  std::vector<uint32_t> remap(vertices.size(), INVALID);
+  std::vector<Vertex> reordered{};
+  reordered.reserve(vertices.size());
+
+  for (auto& index : indices) {
+    if (remap[index] == INVALID) {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices = std::move(reordered);
+}
+
+/**
+ * Meshlets are runs of consecutive triangles, so running this on cache optimized indices keeps
+ * their triangles close together and their bounds tight. The indices aren't reordered, the vertex
+ * cache and overdraw order they were optimized for is what gets drawn
+ */
+std::vector<LveModel::Meshlet> LveMeshOptimizer::buildMeshlets(
+    const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+  const size_t indexCount = indices.size() / 3 * 3;
+  std::vector<LveModel::Meshlet> meshlets{};
+  std::vector<uint32_t> meshletOf(vertices.size(), INVALID);
+  std::vector<uint32_t> meshletVertices{};
+
+  auto finishMeshlet = [&](size_t firstIndex, size_t endIndex) {
+    LveModel::Meshlet meshlet{};
+    meshlet.firstIndex = static_cast<uint32_t>(firstIndex);
+    meshlet.indexCount = static_cast<uint32_t>(endIndex - firstIndex);
+
+    glm::vec3 center{0.f};
+    for (auto v : meshletVertices) {
+      center += vertices[v].position;
+    }
+    center = center * (1.f / static_cast<float>(meshletVertices.size()));
+    float radius = 0.f;
+    for (auto v : meshletVertices) {
+      radius = std::max(radius, glm::length(vertices[v].position - center));
+    }
+    meshlet.boundingSphere = glm::vec4(center, radius);
+
+    // the cone spans the normals of all triangles around their average
+    std::vector<glm::vec3> normals{};
+    glm::vec3 axis{0.f};
+    for (size_t i = firstIndex; i < endIndex; i += 3) {
+      const auto& p0 = vertices[indices[i]].position;
+      glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0,
+                                    vertices[indices[i + 2]].position - p0);
+      float length = glm::length(normal);
+      if (length > 0.f) {
+        normals.push_back(normal * (1.f / length));
+        axis += normals.back();
+      }
+    }
+    float axisLength = glm::length(axis);
+    if (axisLength > 0.f) {
+      axis = axis * (1.f / axisLength);
+      float minDot = 1.f;
+      for (const auto& normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+      }
+      // cones wider than a hemisphere face the camera from every direction
+      if (minDot > 0.f) {
+        meshlet.normalCone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+      }
+    }
+
+    meshlets.push_back(meshlet);
+    meshletVertices.clear();
+  };
+
+  size_t firstIndex = 0;
+  for (size_t i = 0; i < indexCount; i += 3) {
+    auto id = static_cast<uint32_t>(meshlets.size());
+    uint32_t added = 0;
+    for (size_t k = i; k < i + 3; k++) {
+      added += meshletOf[indices[k]] != id ? 1 : 0;
+    }
+    // the triangle starts the next meshlet if it doesn't fit into the current one
+    if (meshletVertices.size() + added > LveModel::MAX_MESHLET_VERTICES ||
+        (i - firstIndex) / 3 == LveModel::MAX_MESHLET_TRIANGLES) {
+      finishMeshlet(firstIndex, i);
+      firstIndex = i;
+      id++;
+    }
+
+    for (size_t k = i; k < i + 3; k++) {
+      uint32_t v = indices[k];
+      if (meshletOf[v] != id) {
+        meshletOf[v] = id;
+        meshletVertices.push_back(v);
+      }
+    }
+  }
+  if (!meshletVertices.empty()) {
+    finishMeshlet(firstIndex, indexCount);
+  }
+  return meshlets;
+}
+
+LveMeshOptimizer::CacheStats LveMeshOptimizer::analyzeVertexCache(
+    const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+  std::vector<uint32_t> stamps(vertexCount, 0);
+  uint32_t time = 0;
+
+  CacheStats stats{};
+  stats.misses = simulateMisses(indices.data(), indices.size(), stamps, time, cacheSize);
+  stats.triangles = indices.size() / 3;
+  stats.vertices = vertexCount;
+  return stats;
+}
+
+} // namespace lve
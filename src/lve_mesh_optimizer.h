@@ -0,0 +1,65 @@
+#pragma once
+
+#include "lve_model.h"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Reorders a triangle mesh for the GPU: exact duplicate vertices are welded, triangles are sorted
+ * for the post-transform vertex cache and then by cluster for less overdraw, and finally vertices
+ * are laid out in the order they are first fetched.
+ *
+ * All functions work on one mesh with indices relative to its own vertices.
+ */
+class LveMeshOptimizer {
+public:
+  using Vertex = LveModel::Vertex;
+
+  // Result of simulating a FIFO vertex cache, ACMR is transformed vertices per triangle and
+  // ATVR transformed vertices per vertex (1.0 is optimal)
+  struct CacheStats {
+    uint64_t misses = 0;
+    uint64_t triangles = 0;
+    uint64_t vertices = 0;
+
+    [[nodiscard]] float acmr() const {
+      return triangles == 0 ? 0.f : static_cast<float>(misses) / static_cast<float>(triangles);
+    }
+    [[nodiscard]] float atvr() const {
+      return vertices == 0 ? 0.f : static_cast<float>(misses) / static_cast<float>(vertices);
+    }
+
+    CacheStats& operator+=(const CacheStats& other) {
+      misses += other.misses;
+      triangles += other.triangles;
+      vertices += other.vertices;
+      return *this;
+    }
+  };
+
+  static constexpr uint32_t ANALYZE_CACHE_SIZE = 16;
+  static constexpr uint32_t OPTIMIZE_CACHE_SIZE = 32;
+  static constexpr float DEFAULT_OVERDRAW_THRESHOLD = 1.05f;
+
+  static void optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+  static void deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+  static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+  static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+                               float threshold = DEFAULT_OVERDRAW_THRESHOLD);
+  static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+  // splits the indices into consecutive runs of at most MAX_MESHLET_VERTICES vertices and
+  // MAX_MESHLET_TRIANGLES triangles, the index order is left as it is
+  static std::vector<LveModel::Meshlet> buildMeshlets(const std::vector<Vertex>& vertices,
+                                                      const std::vector<uint32_t>& indices);
+
+  static CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                       uint32_t cacheSize = ANALYZE_CACHE_SIZE);
+};
+
+} // namespace lve
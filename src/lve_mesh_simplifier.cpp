@@ -0,0 +1,254 @@
+#include "lve_mesh_simplifier.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace lve {
+
+namespace {
+
+// Sum of squared distances to a set of area weighted planes
+struct Quadric {
+  double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+  double b0 = 0, b1 = 0, b2 = 0;
+  double c = 0;
+  double weight = 0;
+
+  void addPlane(const glm::vec3& normal, float distance, double area) {
+    double x = normal.x, y = normal.y, z = normal.z, d = distance;
+    a00 += area * x * x;
+    a11 += area * y * y;
+    a22 += area * z * z;
+    a01 += area * x * y;
+    a02 += area * x * z;
+    a12 += area * y * z;
+    b0 += area * x * d;
+    b1 += area * y * d;
+    b2 += area * z * d;
+    c += area * d * d;
+    weight += area;
+  }
+
+  Quadric& operator+=(const Quadric& other) {
+    a00 += other.a00;
+    a11 += other.a11;
+    a22 += other.a22;
+    a01 += other.a01;
+    a02 += other.a02;
+    a12 += other.a12;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+  }
+
+  // mean squared distance of p to the planes
+  [[nodiscard]] double error(const glm::vec3& p) const {
+    double x = p.x, y = p.y, z = p.z;
+    double result = a00 * x * x + a11 * y * y + a22 * z * z +
+                    2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                    2 * (b0 * x + b1 * y + b2 * z) + c;
+    return weight > 0 ? std::abs(result) / weight : 0;
+  }
+};
+
+struct PositionHash {
+  size_t operator()(const glm::vec3& position) const {
+    uint32_t bits[3];
+    std::memcpy(bits, &position, sizeof(bits));
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+  }
+};
+
+struct PositionEqual {
+  bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (uint64_t{a} << 32) | b : (uint64_t{b} << 32) | a;
+}
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+} // namespace
+
+std::vector<uint32_t> LveMeshSimplifier::simplify(const std::vector<LveModel::Vertex>& vertices,
+                                                  const std::vector<uint32_t>& indices,
+                                                  size_t targetIndexCount, float targetError,
+                                                  float& resultError) {
+  const size_t vertexCount = vertices.size();
+  resultError = 0.f;
+
+  std::vector<bool> locked(vertexCount, false);
+  {
+    std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> positions{};
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      auto [it, inserted] = positions.emplace(vertices[v].position, v);
+      if (!inserted) {
+        locked[v] = true;
+        locked[it->second] = true;
+      }
+    }
+
+    // edges used by a single triangle are borders, more than two make the mesh non-manifold
+    std::unordered_map<uint64_t, uint32_t> edgeUses{};
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (int e = 0; e < 3; e++) {
+        edgeUses[edgeKey(indices[i + e], indices[i + (e + 1) % 3])]++;
+      }
+    }
+    for (const auto& [key, uses] : edgeUses) {
+      if (uses != 2) {
+        locked[static_cast<uint32_t>(key >> 32)] = true;
+        locked[static_cast<uint32_t>(key)] = true;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    const auto& p0 = vertices[indices[i]].position;
+    const auto& p1 = vertices[indices[i + 1]].position;
+    const auto& p2 = vertices[indices[i + 2]].position;
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+    float doubleArea = glm::length(normal);
+    if (doubleArea == 0.f) {
+      continue;
+    }
+    normal = normal * (1.f / doubleArea);
+    for (int k = 0; k < 3; k++) {
+      quadrics[indices[i + k]].addPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5);
+    }
+  }
+
+  const double errorLimit = static_cast<double>(targetError) * targetError;
+  std::vector<uint32_t> result = indices;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+  std::vector<uint32_t> adjacency{};
+  std::vector<Collapse> collapses{};
+
+  // every pass collapses a set of edges whose neighbourhoods don't overlap, cheapest first
+  while (result.size() > targetIndexCount) {
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int e = 0; e < 3; e++) {
+        uint32_t a = result[i + e];
+        uint32_t b = result[i + (e + 1) % 3];
+        // interior edges are shared by two triangles with opposite winding, take them once
+        if (a > b || (locked[a] && locked[b])) {
+          continue;
+        }
+
+        Quadric merged = quadrics[a];
+        merged += quadrics[b];
+        double costAB = locked[a] ? HUGE_VAL : merged.error(vertices[b].position);
+        double costBA = locked[b] ? HUGE_VAL : merged.error(vertices[a].position);
+        collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB} : Collapse{b, a, costBA});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for (auto index : result) {
+      adjacencyOffsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    adjacency.resize(result.size());
+    {
+      std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+      for (size_t i = 0; i < result.size(); i++) {
+        adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      remap[v] = v;
+    }
+    std::fill(touched.begin(), touched.end(), false);
+
+    // a collapse removes about two triangles
+    size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+    size_t trianglesRemoved = 0;
+    for (const auto& collapse : collapses) {
+      if (collapse.cost > errorLimit || trianglesRemoved >= trianglesToRemove) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+
+      // moving the vertex must not flip any of the triangles that survive the collapse
+      bool flips = false;
+      for (uint32_t i = adjacencyOffsets[collapse.from];
+           i < adjacencyOffsets[collapse.from + 1] && !flips; i++) {
+        const uint32_t* triangle = &result[adjacency[i] * 3];
+        if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+            triangle[2] == collapse.to) {
+          continue;
+        }
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        for (int k = 0; k < 3; k++) {
+          before[k] = vertices[triangle[k]].position;
+          after[k] = triangle[k] == collapse.from ? vertices[collapse.to].position : before[k];
+        }
+        glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+        flips = glm::dot(normalBefore, normalAfter) <= 0.f;
+      }
+      if (flips) {
+        continue;
+      }
+
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to] += quadrics[collapse.from];
+      resultError = std::max(resultError, static_cast<float>(std::sqrt(collapse.cost)));
+      trianglesRemoved += 2;
+
+      // the neighbourhood changed, its remaining candidates were costed against stale geometry
+      touched[collapse.to] = true;
+      for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1];
+           i++) {
+        const uint32_t* triangle = &result[adjacency[i] * 3];
+        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+      }
+    }
+
+    if (trianglesRemoved == 0) {
+      break;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+      if (a != b && b != c && a != c) {
+        result[written++] = a;
+        result[written++] = b;
+        result[written++] = c;
+      }
+    }
+    result.resize(written);
+  }
+
+  return result;
+}
+
+} // namespace lve
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "lve_model.h"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Quadric error metric edge collapse simplification after Garland and Heckbert, "Surface
+ * Simplification Using Quadric Error Metrics".
+ *
+ * Vertices are only ever collapsed onto other existing vertices, so the simplified indices keep
+ * referencing the original vertices and a LOD chain can share one vertex buffer. Vertices on open
+ * borders and on attribute seams (several vertices at one position) are never moved.
+ */
+class LveMeshSimplifier {
+public:
+  /**
+   * @param targetIndexCount Index count to stop at, the result may stay above it when further
+   * collapses would exceed targetError
+   * @param targetError Largest allowed deviation from the original surface, in model units
+   * @param resultError Deviation of the returned mesh
+   *
+   * @return Indices of the simplified mesh, relative to the same vertices
+   */
+  static std::vector<uint32_t> simplify(const std::vector<LveModel::Vertex>& vertices,
+                                        const std::vector<uint32_t>& indices,
+                                        size_t targetIndexCount, float targetError,
+                                        float& resultError);
+};
+
+} // namespace lve
@@ -1,169 +1,381 @@
 
 #include "lve_model.h"
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
+#include "lve_mesh_file.h"
+#include "rendering/lve_deletion_queue.h"
 #include <fmt/core.h>
+#include <glm/gtc/matrix_inverse.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <future>
+#include <limits>
+#include <unordered_map>
+#include <utility>
 
 namespace lve {
-LveModel::LveModel(LveDevice& device, const LveModel::Builder& builder) : lveDevice(device) {
-  createVertexBuffers(builder.vertices);
-  createIndexBuffer(builder.indices);
+
+static_assert(sizeof(LveModel::Meshlet) == 48,
+              "Meshlet must match the std430 layout of the shader");
+static_assert(sizeof(LveModel::PackedVertex::Position) == 8 &&
+                  sizeof(LveModel::PackedVertex::Attributes) == 12,
+              "PackedVertex streams must stay tightly packed");
+
+LveModel::LveModel(LveDevice& device, const MeshData& data, VertexFormat format)
+    : lveDevice(device), vertexFormat(format) {
+  // both copies go out in a single submission, drawing waits until it has completed
+  LveUploadBatch batch{lveDevice};
+  allocateSpans(data);
+  createVertexBuffers(data, batch);
+  createIndexBuffer(data, batch);
+  createMeshletBuffer(data, batch);
+  createSubmeshes(data);
+  uploadTicket = batch.ticket();
+  batch.submit();
 }
 
-LveModel::~LveModel() {}
+LveModel::LveModel(LveDevice& device, const MeshData& data, LveUploadBatch& batch,
+                   VertexFormat format)
+    : lveDevice(device), vertexFormat(format) {
+  allocateSpans(data);
+  createVertexBuffers(data, batch);
+  createIndexBuffer(data, batch);
+  createMeshletBuffer(data, batch);
+  createSubmeshes(data);
+  uploadTicket = batch.ticket();
+}
+
+LveModel::~LveModel() {
+  // frames in flight may still draw the spans, and an upload reusing them would overwrite them
+  lveDevice.deletionQueue().push([&arena = lveDevice.geometryArena(), vertices = vertexSpan,
+                                  indices = indexSpan, indexType = indexType,
+                                  meshlets = meshletSpan]() mutable {
+    arena.freeVertices(vertices);
+    arena.freeIndices(indices, indexType);
+    arena.freeMeshlets(meshlets);
+  });
+}
 
-void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-  vertexCount = static_cast<uint32_t>(vertices.size());
+/**
+ * Reserves every span in the geometry arena before anything is uploaded, so if the arena is full
+ * nothing was staged for the spans reserved so far and they are returned right away
+ */
+void LveModel::allocateSpans(const MeshData& data) {
+  vertexCount = data.vertexCount;
   assert(vertexCount >= 3 && "Vertex count must be at least 3");
+  indexCount = data.indexCount;
+  hasIndexBuffer = indexCount > 0;
+  // indices are relative to their submesh, so they always fit 16 bits when the whole model does.
+  // 0xffff is left out as it is the primitive restart index
+  indexType = vertexCount < std::numeric_limits<uint16_t>::max() ? VK_INDEX_TYPE_UINT16
+                                                                  : VK_INDEX_TYPE_UINT32;
+  LveVertexLayout layout =
+      vertexFormat == VertexFormat::Float
+          ? LveVertexLayout{sizeof(glm::vec3), sizeof(Vertex::Attributes)}
+          : LveVertexLayout{sizeof(PackedVertex::Position), sizeof(PackedVertex::Attributes)};
+
+  auto& arena = lveDevice.geometryArena();
+  try {
+    vertexSpan = arena.allocateVertices(vertexCount, layout);
+    if (hasIndexBuffer) {
+      indexSpan = arena.allocateIndices(indexCount, indexType);
+    }
+    // meshlets cover indices, non indexed models are always drawn whole
+    if (data.meshletCount > 0 && hasIndexBuffer) {
+      meshletSpan = arena.allocateMeshlets(data.meshletCount, sizeof(Meshlet));
+    }
+  } catch (...) {
+    // the destructor doesn't run for a model that failed to construct
+    arena.freeVertices(vertexSpan);
+    arena.freeIndices(indexSpan, indexType);
+    throw;
+  }
+}
 
-  uint32_t vertexSize = sizeof(vertices[0]);
+void LveModel::createVertexBuffers(const MeshData& data, LveUploadBatch& batch) {
+  // the streams are converted straight into the staging ring, no copy of them is kept around
+  if (vertexFormat == VertexFormat::Float) {
+    createFloatStreams(data, batch);
+  } else {
+    createPackedStreams(data, batch);
+  }
+}
 
-  LveBuffer stagingBuffer{lveDevice, vertexSize, vertexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+void LveModel::createFloatStreams(const MeshData& data, LveUploadBatch& batch) {
+  auto& arena = lveDevice.geometryArena();
+  batch.uploadElements(arena.getPositionBuffer(vertexSpan.pool), vertexSpan.positionOffset,
+                       sizeof(glm::vec3), vertexCount,
+                       [&](void* dst, uint32_t first, uint32_t count) {
+                         auto positions = static_cast<glm::vec3*>(dst);
+                         for (uint32_t i = 0; i < count; i++) {
+                           positions[i] = data.vertices[first + i].position;
+                         }
+                       });
+  batch.uploadElements(arena.getAttributeBuffer(vertexSpan.pool), vertexSpan.attributeOffset,
+                       sizeof(Vertex::Attributes), vertexCount,
+                       [&](void* dst, uint32_t first, uint32_t count) {
+                         auto attributes = static_cast<Vertex::Attributes*>(dst);
+                         for (uint32_t i = 0; i < count; i++) {
+                           const auto& vertex = data.vertices[first + i];
+                           attributes[i] = {vertex.color, vertex.normal, vertex.uv};
+                         }
+                       });
+}
 
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void*)vertices.data());
+// the streams were quantized when the mesh was built or cooked and go out as they are
+void LveModel::createPackedStreams(const MeshData& data, LveUploadBatch& batch) {
+  assert(data.packedPositions != nullptr && data.packedAttributes != nullptr &&
+         "Packed models need the streams of Builder::packVertices");
+  positionOffset = data.positionOffset;
+  positionScale = data.positionScale;
+
+  auto& arena = lveDevice.geometryArena();
+  batch.uploadBuffer(arena.getPositionBuffer(vertexSpan.pool), vertexSpan.positionOffset,
+                     data.packedPositions, vertexCount * sizeof(PackedVertex::Position));
+  batch.uploadBuffer(arena.getAttributeBuffer(vertexSpan.pool), vertexSpan.attributeOffset,
+                     data.packedAttributes, vertexCount * sizeof(PackedVertex::Attributes));
+}
 
-  vertexBuffer = std::make_unique<LveBuffer>(lveDevice, vertexSize, vertexCount,
+void LveModel::createIndexBuffer(const MeshData& data, LveUploadBatch& batch) {
+  if (!hasIndexBuffer) {
+    return;
+  }
 
-                                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  auto& arena = lveDevice.geometryArena();
+  if (indexType == VK_INDEX_TYPE_UINT16) {
+    batch.uploadElements(arena.getIndexBuffer(indexType), indexSpan.offset, sizeof(uint16_t),
+                         indexCount, [&](void* dst, uint32_t first, uint32_t count) {
+                           std::copy(data.indices + first, data.indices + first + count,
+                                     static_cast<uint16_t*>(dst));
+                         });
+    return;
+  }
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(),
-                       // kann weg?
-                       stagingBuffer.getBufferSize());
+  // 32 bit indices and meshlets go from the source, the mapping of cooked meshes, straight into
+  // the staging ring
+  batch.uploadBuffer(arena.getIndexBuffer(indexType), indexSpan.offset, data.indices,
+                     indexSpan.size);
 }
 
-void LveModel::createIndexBuffer(const std::vector<uint32_t>& indices) {
-  indexCount = static_cast<uint32_t>(indices.size());
-  hasIndexBuffer = indexCount > 0;
-
-  if (!hasIndexBuffer) {
+void LveModel::createMeshletBuffer(const MeshData& data, LveUploadBatch& batch) {
+  if (!meshletSpan.isValid()) {
     return;
   }
 
-  uint32_t indexSize = sizeof(indices[0]);
+  auto& arena = lveDevice.geometryArena();
+  batch.uploadBuffer(arena.getMeshletBuffer(), meshletSpan.offset, data.meshlets,
+                     meshletSpan.size);
+}
 
-  LveBuffer stagingBuffer{lveDevice, indexSize, indexCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+void LveModel::createSubmeshes(const MeshData& data) {
+  submeshes.assign(data.submeshes, data.submeshes + data.submeshCount);
+  if (submeshes.empty()) {
+    submeshes.push_back({0, indexCount, 0, vertexCount, glm::mat4{1.f}});
+  }
+  submeshNormalMatrices.clear();
+  submeshNormalMatrices.reserve(submeshes.size());
+  for (const auto& submesh : submeshes) {
+    submeshNormalMatrices.push_back(glm::inverseTranspose(glm::mat3{submesh.transform}));
+  }
+  lods.assign(data.lods, data.lods + data.lodCount);
+  if (lods.empty()) {
+    lods.push_back({0, static_cast<uint32_t>(submeshes.size()), 0.f});
+  }
+  boundsMin = data.boundsMin;
+  boundsMax = data.boundsMax;
+}
 
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void*)indices.data());
+void LveModel::bind(VkCommandBuffer commandBuffer) const {
+  auto& arena = lveDevice.geometryArena();
+  arena.bindVertices(commandBuffer, vertexSpan.pool);
+  if (hasIndexBuffer) {
+    arena.bindIndices(commandBuffer, indexType);
+  }
+}
 
-  indexBuffer = std::make_unique<LveBuffer>(lveDevice, indexSize, vertexCount,
+void LveModel::bindPositions(VkCommandBuffer commandBuffer) const {
+  auto& arena = lveDevice.geometryArena();
+  arena.bindPositions(commandBuffer, vertexSpan.pool);
+  if (hasIndexBuffer) {
+    arena.bindIndices(commandBuffer, indexType);
+  }
+}
 
-                                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+void LveModel::draw(VkCommandBuffer commandBuffer, uint32_t lod) const {
+  const auto& level = lods[lod];
+  for (uint32_t i = 0; i < level.submeshCount; i++) {
+    drawSubmesh(commandBuffer, submeshes[level.firstSubmesh + i]);
+  }
+}
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(),
-                       // kann weg?
-                       stagingBuffer.getBufferSize());
+void LveModel::swapGeometry(LveModel& other) {
+  assert(&lveDevice == &other.lveDevice && "Models must belong to the same device");
+  std::swap(uploadTicket, other.uploadTicket);
+  std::swap(vertexFormat, other.vertexFormat);
+  std::swap(vertexSpan, other.vertexSpan);
+  std::swap(vertexCount, other.vertexCount);
+  std::swap(positionScale, other.positionScale);
+  std::swap(positionOffset, other.positionOffset);
+  std::swap(hasIndexBuffer, other.hasIndexBuffer);
+  std::swap(indexSpan, other.indexSpan);
+  std::swap(indexCount, other.indexCount);
+  std::swap(indexType, other.indexType);
+  std::swap(meshletSpan, other.meshletSpan);
+  std::swap(submeshes, other.submeshes);
+  std::swap(submeshNormalMatrices, other.submeshNormalMatrices);
+  std::swap(lods, other.lods);
+  std::swap(boundsMin, other.boundsMin);
+  std::swap(boundsMax, other.boundsMax);
 }
 
-void LveModel::bind(VkCommandBuffer commandBuffer) {
-  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+void LveModel::drawSubmesh(VkCommandBuffer commandBuffer, const Submesh& submesh) const {
   if (hasIndexBuffer) {
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(commandBuffer, submesh.indexCount, 1, getFirstIndex() + submesh.firstIndex,
+                     getVertexOffset() + submesh.vertexOffset, 0);
+  } else {
+    vkCmdDraw(commandBuffer, submesh.vertexCount, 1,
+              static_cast<uint32_t>(getVertexOffset() + submesh.vertexOffset), 0);
   }
 }
 
-void LveModel::draw(VkCommandBuffer commandBuffer) const {
-  if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+std::unique_ptr<LveMeshSource> LveMeshSource::load(const std::string& filepath) {
+  auto mesh = std::make_unique<LveMeshSource>();
+  // the cooked mesh is uploaded straight out of the file mapping
+  mesh->isCooked = mesh->cooked.open(LveMeshFile::cookedPathFor(filepath), filepath);
+  if (!mesh->isCooked) {
+    mesh->builder.loadModel(filepath);
   }
-  vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+
+  auto data = mesh->data();
+  fmt::println("{}: vertex count: {}, submeshes: {}, lods: {}, meshlets: {}{}", filepath,
+               data.vertexCount, data.submeshCount, data.lodCount, data.meshletCount,
+               mesh->isCooked ? " (cooked)" : "");
+  return mesh;
 }
 
 std::unique_ptr<LveModel> LveModel::createModelFromFile(LveDevice& device,
-                                                        const std::string& filepath) {
-  Builder builder{};
-  builder.loadModel(filepath);
+                                                        const std::string& filepath,
+                                                        VertexFormat format) {
+  auto mesh = LveMeshSource::load(filepath);
+  return std::make_unique<LveModel>(device, mesh->data(), format);
+}
 
-  fmt::println("Vertex count: {}", builder.vertices.size());
+std::vector<std::shared_ptr<LveModel>> LveModel::createModelsFromFiles(
+    LveDevice& device, LveThreadPool& threadPool, const std::vector<std::string>& filepaths,
+    VertexFormat format) {
+  // every worker job runs its own Assimp importer, they share no state
+  std::unordered_map<std::string, std::future<std::unique_ptr<LveMeshSource>>> pending{};
+  for (const auto& filepath : filepaths) {
+    if (pending.count(filepath) == 0) {
+      pending.emplace(filepath,
+                      threadPool.submit([filepath]() { return LveMeshSource::load(filepath); }));
+    }
+  }
 
-  return std::make_unique<LveModel>(device, builder);
+  // models are created on this thread as results come in, the copies go out together at the end
+  LveUploadBatch batch{device};
+  std::unordered_map<std::string, std::shared_ptr<LveModel>> models{};
+  for (const auto& filepath : filepaths) {
+    auto& model = models[filepath];
+    if (model == nullptr) {
+      auto mesh = pending.at(filepath).get();
+      model = std::make_shared<LveModel>(device, mesh->data(), batch, format);
+    }
+  }
+  batch.submit();
+
+  std::vector<std::shared_ptr<LveModel>> result{};
+  result.reserve(filepaths.size());
+  for (const auto& filepath : filepaths) {
+    result.push_back(models.at(filepath));
+  }
+  return result;
 }
 
 std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescription() {
-  std::vector<VkVertexInputBindingDescription> bindingDescriptions{1};
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{2};
   bindingDescriptions[0].binding = 0;
-  bindingDescriptions[0].stride = sizeof(Vertex);
+  bindingDescriptions[0].stride = sizeof(glm::vec3);
   bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
+  bindingDescriptions[1].binding = 1;
+  bindingDescriptions[1].stride = sizeof(Attributes);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
   return bindingDescriptions;
 }
 
 std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescription() {
   std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-  attributeDescriptions.push_back(
-      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, position))});
+  attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0});
 
   attributeDescriptions.push_back(
-      {1, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, color))});
+      {1, 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Attributes, color))});
 
   attributeDescriptions.push_back(
-      {2, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, normal))});
+      {2, 1, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(Attributes, normal))});
 
   attributeDescriptions.push_back(
-      {3, 0, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Vertex, uv))});
+      {3, 1, VK_FORMAT_R32G32_SFLOAT, static_cast<uint32_t>(offsetof(Attributes, uv))});
   return attributeDescriptions;
 }
 
-void LveModel::Builder::loadModel(const std::string& filepath) {
-  Assimp::Importer importer{};
-  const aiScene* scene = importer.ReadFile(filepath, aiProcess_Triangulate);
+std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getPositionBindingDescription() {
+  auto bindingDescriptions = getBindingDescription();
+  bindingDescriptions.resize(1);
+  return bindingDescriptions;
+}
 
-  assert(scene != nullptr && "Couldn't load  model!");
+std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getPositionAttributeDescription() {
+  auto attributeDescriptions = getAttributeDescription();
+  attributeDescriptions.resize(1);
+  return attributeDescriptions;
+}
 
-  vertices.clear();
-  indices.clear();
-  vertices.resize(scene->mMeshes[0]->mNumVertices);
+std::vector<VkVertexInputBindingDescription> LveModel::PackedVertex::getBindingDescription() {
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{2};
+  bindingDescriptions[0].binding = 0;
+  bindingDescriptions[0].stride = sizeof(Position);
+  bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  const auto mesh = scene->mMeshes[0];
+  bindingDescriptions[1].binding = 1;
+  bindingDescriptions[1].stride = sizeof(Attributes);
+  bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  for (int i = 0; i < mesh->mNumVertices; i++) {
-    const auto vertex = mesh->mVertices[i];
-    vertices[i].position = {vertex.x, vertex.y, vertex.z};
-    vertices[i].color = {1.f, 1.f, 0.8f};
+  return bindingDescriptions;
+}
 
-    const auto normal = mesh->mNormals[i];
-    vertices[i].normal = {normal.x, normal.y, normal.z};
-  }
+/**
+ * Same locations as Vertex, so both formats work with the same vertex shader. Position has four
+ * components as three component 16 bit formats are rarely supported for vertex input, the normal
+ * reads as (x, y, 0) and has to be decoded
+ */
+std::vector<VkVertexInputAttributeDescription> LveModel::PackedVertex::getAttributeDescription() {
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+  attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, 0});
 
-  if (mesh->HasTextureCoords(0)) {
-    for (int i = 0; i < mesh->mNumVertices; i++) {
-      const auto texCoord = mesh->mTextureCoords[0][i];
-      vertices[i].uv = {texCoord.x, texCoord.y};
-    }
-  }
+  attributeDescriptions.push_back(
+      {1, 1, VK_FORMAT_R8G8B8A8_UNORM, static_cast<uint32_t>(offsetof(Attributes, color))});
 
-  if (mesh->HasVertexColors(0)) {
-    for (int i = 0; i < mesh->mNumVertices; i++) {
-      const auto texCoord = mesh->mColors[0][i];
-      vertices[i].color = {texCoord.r, texCoord.g, texCoord.b};
-    }
-  }
+  attributeDescriptions.push_back(
+      {2, 1, VK_FORMAT_R16G16_SNORM, static_cast<uint32_t>(offsetof(Attributes, normal))});
 
-  //  for (auto& v : modelBuilder.vertices) {
-  //    v.position += offset;
-  //  }
+  attributeDescriptions.push_back(
+      {3, 1, VK_FORMAT_R16G16_SFLOAT, static_cast<uint32_t>(offsetof(Attributes, uv))});
+  return attributeDescriptions;
+}
 
-  indices.clear();
-  indices.resize(mesh->mNumFaces * 3);
+std::vector<VkVertexInputBindingDescription>
+LveModel::PackedVertex::getPositionBindingDescription() {
+  auto bindingDescriptions = getBindingDescription();
+  bindingDescriptions.resize(1);
+  return bindingDescriptions;
+}
 
-  for (int i = 0; i < mesh->mNumFaces; i++) {
-    const auto face = mesh->mFaces[i];
-    assert(face.mNumIndices == 3 && "model faces are expected to be triangles!");
-    for (int j = 0; j < face.mNumIndices; j++) {
-      indices[i * 3 + j] = face.mIndices[j];
-    }
-  }
+std::vector<VkVertexInputAttributeDescription>
+LveModel::PackedVertex::getPositionAttributeDescription() {
+  auto attributeDescriptions = getAttributeDescription();
+  attributeDescriptions.resize(1);
+  return attributeDescriptions;
 }
 } // namespace lve
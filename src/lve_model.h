@@ -1,58 +1,268 @@
 
 #pragma once
 
-#include "rendering/lve_buffer.h"
+#include "lve_thread_pool.h"
 #include "rendering/lve_device.h"
+#include "rendering/lve_geometry_arena.h"
+#include "rendering/lve_upload_batch.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace lve {
 class LveModel {
 public:
+  // On the GPU every model keeps its positions in a stream of their own (binding 0) and all other
+  // attributes in a second one (binding 1), so depth only passes fetch nothing but positions
   struct Vertex {
     glm::vec3 position{};
     glm::vec3 color{};
     glm::vec3 normal{};
     glm::vec2 uv{};
 
+    // attribute stream of VertexFormat::Float, the position stream holds plain vec3s
+    struct Attributes {
+      glm::vec3 color{};
+      glm::vec3 normal{};
+      glm::vec2 uv{};
+    };
+
     static std::vector<VkVertexInputBindingDescription> getBindingDescription();
 
     static std::vector<VkVertexInputAttributeDescription> getAttributeDescription();
+
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescription();
+
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescription();
+  };
+
+  // Streams of VertexFormat::Packed, 20 instead of 44 bytes per vertex. Positions are unorm16
+  // within the model's position bounds and have to be dequantized with
+  // getPositionScale/getPositionOffset, normals are octahedral encoded, uvs are half floats
+  struct PackedVertex {
+    struct Position {
+      uint16_t position[4]{};
+    };
+
+    struct Attributes {
+      int16_t normal[2]{};
+      uint16_t uv[2]{};
+      uint8_t color[4]{};
+    };
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescription();
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescription();
+
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescription();
+
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescription();
+  };
+
+  enum class VertexFormat { Float, Packed };
+
+  // A mesh placed by a node of the source asset. Indices are relative to vertexOffset, the
+  // transform is the node's accumulated transform relative to the model
+  struct Submesh {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t vertexOffset = 0;
+    uint32_t vertexCount = 0;
+    glm::mat4 transform{1.f};
+    // clusters covering the submesh's indices in order, see Meshlet
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+  };
+
+  // A cluster of a submesh's triangles, laid out as the culling shader reads it. Clusters that are
+  // entirely outside the frustum or face away from the camera are skipped, see MeshletCullSystem
+  struct Meshlet {
+    // center and radius in model space, before the submesh transform
+    glm::vec4 boundingSphere{};
+    // axis and cutoff: the cluster faces away from every view direction v with
+    // dot(normalize(v), axis) >= cutoff, a cutoff of 1 never culls
+    glm::vec4 normalCone{0.f, 0.f, 0.f, 1.f};
+    // relative to the submesh's firstIndex
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    uint32_t padding[2]{};
+  };
+
+  static constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+  static constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+  // A level of detail, the submeshes it draws and how far, in model units, it deviates from the
+  // full resolution surface. Every level draws the same vertices with its own indices
+  struct Lod {
+    uint32_t firstSubmesh = 0;
+    uint32_t submeshCount = 0;
+    float error = 0.f;
+  };
+
+  static constexpr uint32_t MAX_LODS = 4;
+
+  // Non-owning view of the data a model is created from, a Builder or a cooked mesh file
+  struct MeshData {
+    const Vertex* vertices = nullptr;
+    uint32_t vertexCount = 0;
+    const uint32_t* indices = nullptr;
+    uint32_t indexCount = 0;
+    // no submeshes means a single one covering all vertices and indices
+    const Submesh* submeshes = nullptr;
+    uint32_t submeshCount = 0;
+    // no lods means a single one drawing all submeshes
+    const Lod* lods = nullptr;
+    uint32_t lodCount = 0;
+    const Meshlet* meshlets = nullptr;
+    uint32_t meshletCount = 0;
+    glm::vec3 boundsMin{};
+    glm::vec3 boundsMax{};
+    // the vertices quantized for VertexFormat::Packed, parallel to vertices and needed for it
+    const PackedVertex::Position* packedPositions = nullptr;
+    const PackedVertex::Attributes* packedAttributes = nullptr;
+    glm::vec3 positionOffset{0.f};
+    glm::vec3 positionScale{1.f};
   };
 
   struct Builder {
     std::vector<Vertex> vertices{};
     std::vector<uint32_t> indices{};
+    std::vector<Submesh> submeshes{};
+    std::vector<Lod> lods{};
+    std::vector<Meshlet> meshlets{};
+    glm::vec3 boundsMin{};
+    glm::vec3 boundsMax{};
+    std::vector<PackedVertex::Position> packedPositions{};
+    std::vector<PackedVertex::Attributes> packedAttributes{};
+    glm::vec3 positionOffset{0.f};
+    glm::vec3 positionScale{1.f};
 
     void loadModel(const std::string& filepath);
+    // welds and reorders every mesh for the vertex cache, overdraw and vertex fetch
+    void optimize();
+    // appends simplified levels to the submeshes, the current ones become LOD 0
+    void generateLods();
+    // splits the indices of every submesh of every level into meshlets
+    void buildMeshlets();
+    void computeBounds();
+    // quantizes the final vertices into the PackedVertex streams, see getPositionScale
+    void packVertices();
+    [[nodiscard]] MeshData data() const;
   };
 
-  LveModel(LveDevice& device, const LveModel::Builder& builder);
+  LveModel(LveDevice& device, const MeshData& data, VertexFormat format = VertexFormat::Packed);
+  // records the uploads into batch, the model becomes resident once the batch was submitted
+  LveModel(LveDevice& device, const MeshData& data, LveUploadBatch& batch,
+           VertexFormat format = VertexFormat::Packed);
+  LveModel(LveDevice& device, const LveModel::Builder& builder,
+           VertexFormat format = VertexFormat::Packed)
+      : LveModel(device, builder.data(), format) {}
+  LveModel(LveDevice& device, const LveModel::Builder& builder, LveUploadBatch& batch,
+           VertexFormat format = VertexFormat::Packed)
+      : LveModel(device, builder.data(), batch, format) {}
   ~LveModel();
 
   LveModel(const LveModel&) = delete;
   LveModel& operator=(const LveModel&) = delete;
 
-  static std::unique_ptr<LveModel> createModelFromFile(LveDevice& device,
-                                                       const std::string& filepath);
+  // prefers the cooked .lvemesh next to filepath and only imports the source if it is missing or
+  // stale
+  static std::unique_ptr<LveModel> createModelFromFile(
+      LveDevice& device, const std::string& filepath, VertexFormat format = VertexFormat::Packed);
+  // parses the files in parallel on the pool, all uploads share one batched submission. Models
+  // are returned in the order of filepaths, a path listed twice is loaded once
+  static std::vector<std::shared_ptr<LveModel>> createModelsFromFiles(
+      LveDevice& device, LveThreadPool& threadPool, const std::vector<std::string>& filepaths,
+      VertexFormat format = VertexFormat::Packed);
+
+  // exchanges all geometry with other, for replacing a model in place while it is referenced.
+  // Frames in flight may still draw other afterwards, see LveDeletionQueue
+  void swapGeometry(LveModel& other);
+
+  // false while the geometry is still being uploaded on the transfer queue
+  bool isResident() { return lveDevice.isUploadComplete(*uploadTicket); }
+
+  // binds the arena buffers holding both vertex streams and the indices, needed before drawing.
+  // Models of the same vertex format and index type share them and don't need to be rebound
+  void bind(VkCommandBuffer commandBuffer) const;
+  // binds only the position stream and the indices, for depth prepass and other depth only
+  // pipelines
+  void bindPositions(VkCommandBuffer commandBuffer) const;
+  void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0) const;
+  void drawSubmesh(VkCommandBuffer commandBuffer, const Submesh& submesh) const;
 
-  void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer) const;
+  // submeshes of all levels of detail, see getLods
+  [[nodiscard]] const std::vector<Submesh>& getSubmeshes() const { return submeshes; }
+  // inverse transpose of every submesh transform's upper 3x3, parallel to getSubmeshes
+  [[nodiscard]] const std::vector<glm::mat3>& getSubmeshNormalMatrices() const {
+    return submeshNormalMatrices;
+  }
+  // finest first, never empty
+  [[nodiscard]] const std::vector<Lod>& getLods() const { return lods; }
+  [[nodiscard]] glm::vec3 getBoundsMin() const { return boundsMin; }
+  [[nodiscard]] glm::vec3 getBoundsMax() const { return boundsMax; }
+  // bytes the model occupies in the geometry arena
+  [[nodiscard]] VkDeviceSize getMemorySize() const {
+    return vertexSpan.size + indexSpan.size + meshletSpan.size;
+  }
+
+  // where the model starts in the buffers bound by bind, added to the offsets of its submeshes
+  [[nodiscard]] uint32_t getFirstIndex() const { return indexSpan.first; }
+  [[nodiscard]] int32_t getVertexOffset() const { return static_cast<int32_t>(vertexSpan.first); }
+
+  // index of the model's first meshlet in the geometry arena's meshlet buffer
+  [[nodiscard]] uint32_t getFirstMeshlet() const { return meshletSpan.first; }
+  [[nodiscard]] bool hasMeshlets() const { return meshletSpan.isValid(); }
+
+  [[nodiscard]] VertexFormat getVertexFormat() const { return vertexFormat; }
+  [[nodiscard]] VkIndexType getIndexType() const { return indexType; }
+  // position = positionOffset + vertex position * positionScale, identity for VertexFormat::Float
+  [[nodiscard]] glm::vec3 getPositionScale() const { return positionScale; }
+  [[nodiscard]] glm::vec3 getPositionOffset() const { return positionOffset; }
 
 private:
-  void createVertexBuffers(const std::vector<Vertex>& vertices);
-  void createIndexBuffer(const std::vector<uint32_t>& indices);
+  void allocateSpans(const MeshData& data);
+  void createVertexBuffers(const MeshData& data, LveUploadBatch& batch);
+  void createFloatStreams(const MeshData& data, LveUploadBatch& batch);
+  void createPackedStreams(const MeshData& data, LveUploadBatch& batch);
+  void createIndexBuffer(const MeshData& data, LveUploadBatch& batch);
+  void createMeshletBuffer(const MeshData& data, LveUploadBatch& batch);
+  void createSubmeshes(const MeshData& data);
 
   LveDevice& lveDevice;
-  std::unique_ptr<LveBuffer> vertexBuffer;
+  std::shared_ptr<const UploadTicket> uploadTicket;
+  VertexFormat vertexFormat;
+  LveVertexSpan vertexSpan{};
   uint32_t vertexCount{};
+  glm::vec3 positionScale{1.f};
+  glm::vec3 positionOffset{0.f};
 
   bool hasIndexBuffer = false;
-  std::unique_ptr<LveBuffer> indexBuffer;
+  LveGeometrySpan indexSpan{};
   uint32_t indexCount{};
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+  LveGeometrySpan meshletSpan{};
+
+  std::vector<Submesh> submeshes{};
+  // not part of Submesh, which is stored in cooked mesh files as it is
+  std::vector<glm::mat3> submeshNormalMatrices{};
+  std::vector<Lod> lods{};
+  glm::vec3 boundsMin{};
+  glm::vec3 boundsMax{};
+};
+
+// A model requested from LveModelRegistry::request, model stays null until it was created
+struct LveModelStream {
+  std::shared_ptr<LveModel> model{};
+  // set if the file could not be loaded, model will never be created then
+  bool failed = false;
+
+  [[nodiscard]] bool isResident() const { return model != nullptr && model->isResident(); }
 };
 } // namespace lve
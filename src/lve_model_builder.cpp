@@ -0,0 +1,392 @@
+#include "lve_mapped_io_system.h"
+#include "lve_mesh_optimizer.h"
+#include "lve_mesh_simplifier.h"
+#include "lve_model.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <fmt/core.h>
+#include <glm/gtc/packing.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace lve {
+
+// assimp matrices are row major, glm ones column major
+static glm::mat4 toGlm(const aiMatrix4x4& m) {
+  return glm::mat4{m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+                   m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4};
+}
+
+// maps a unit vector onto the octahedron and unfolds its lower half, both components in [-1, 1]
+static glm::vec2 octahedralEncode(glm::vec3 n) {
+  n = n * (1.f / (std::abs(n.x) + std::abs(n.y) + std::abs(n.z)));
+  if (n.z >= 0.f) {
+    return {n.x, n.y};
+  }
+  return {(1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+          (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f)};
+}
+
+void LveModel::Builder::loadModel(const std::string& filepath) {
+  Assimp::Importer importer{};
+  // the importer takes ownership of the file system
+  importer.SetIOHandler(new LveMappedIOSystem());
+  // points and lines end up in meshes of their own, which are skipped below
+  const aiScene* scene = importer.ReadFile(
+      filepath, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_SortByPType);
+
+  // reloads keep the old model if this throws
+  if (scene == nullptr) {
+    throw std::runtime_error("failed to load model " + filepath + ": " +
+                             importer.GetErrorString());
+  }
+
+  vertices.clear();
+  indices.clear();
+  submeshes.clear();
+  lods.clear();
+  meshlets.clear();
+
+  // every mesh is stored once, nodes referencing it share its vertices and indices
+  std::vector<Submesh> meshRanges(scene->mNumMeshes);
+  for (uint32_t m = 0; m < scene->mNumMeshes; m++) {
+    const auto mesh = scene->mMeshes[m];
+    if ((mesh->mPrimitiveTypes & aiPrimitiveType_TRIANGLE) == 0) {
+      continue;
+    }
+
+    auto& range = meshRanges[m];
+    range.firstIndex = static_cast<uint32_t>(indices.size());
+    range.vertexOffset = static_cast<int32_t>(vertices.size());
+    range.vertexCount = mesh->mNumVertices;
+
+    size_t base = vertices.size();
+    vertices.resize(base + mesh->mNumVertices);
+
+    for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
+      auto& vertex = vertices[base + i];
+      const auto position = mesh->mVertices[i];
+      vertex.position = {position.x, position.y, position.z};
+      vertex.color = {1.f, 1.f, 0.8f};
+
+      const auto normal = mesh->mNormals[i];
+      vertex.normal = {normal.x, normal.y, normal.z};
+    }
+
+    if (mesh->HasTextureCoords(0)) {
+      for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
+        const auto texCoord = mesh->mTextureCoords[0][i];
+        vertices[base + i].uv = {texCoord.x, texCoord.y};
+      }
+    }
+
+    if (mesh->HasVertexColors(0)) {
+      for (uint32_t i = 0; i < mesh->mNumVertices; i++) {
+        const auto color = mesh->mColors[0][i];
+        vertices[base + i].color = {color.r, color.g, color.b};
+      }
+    }
+
+    for (uint32_t i = 0; i < mesh->mNumFaces; i++) {
+      const auto face = mesh->mFaces[i];
+      assert(face.mNumIndices == 3 && "model faces are expected to be triangles!");
+      for (uint32_t j = 0; j < face.mNumIndices; j++) {
+        indices.push_back(face.mIndices[j]);
+      }
+    }
+    range.indexCount = static_cast<uint32_t>(indices.size()) - range.firstIndex;
+  }
+  if (indices.empty()) {
+    throw std::runtime_error("failed to load model " + filepath + ": no triangle mesh!");
+  }
+
+  // walk the node hierarchy, each mesh reference becomes a submesh with the node's transform
+  std::vector<std::pair<const aiNode*, glm::mat4>> stack{{scene->mRootNode, glm::mat4{1.f}}};
+  while (!stack.empty()) {
+    auto [node, parentTransform] = stack.back();
+    stack.pop_back();
+
+    glm::mat4 transform = parentTransform * toGlm(node->mTransformation);
+    for (uint32_t i = 0; i < node->mNumMeshes; i++) {
+      Submesh submesh = meshRanges[node->mMeshes[i]];
+      if (submesh.indexCount == 0) {
+        continue;
+      }
+      submesh.transform = transform;
+      submeshes.push_back(submesh);
+    }
+    for (uint32_t i = 0; i < node->mNumChildren; i++) {
+      stack.emplace_back(node->mChildren[i], transform);
+    }
+  }
+
+  optimize();
+  generateLods();
+  buildMeshlets();
+  computeBounds();
+  packVertices();
+}
+
+void LveModel::Builder::optimize() {
+  if (submeshes.empty()) {
+    submeshes.push_back({0, static_cast<uint32_t>(indices.size()), 0,
+                         static_cast<uint32_t>(vertices.size()), glm::mat4{1.f}});
+  }
+
+  std::vector<Vertex> optimizedVertices{};
+  std::vector<uint32_t> optimizedIndices{};
+  LveMeshOptimizer::CacheStats before{};
+  LveMeshOptimizer::CacheStats after{};
+
+  // submeshes instancing the same mesh share its range, so every range is optimized once
+  std::map<std::pair<uint32_t, int32_t>, Submesh> optimizedRanges{};
+  for (auto& submesh : submeshes) {
+    auto key = std::make_pair(submesh.firstIndex, submesh.vertexOffset);
+    auto it = optimizedRanges.find(key);
+    if (it == optimizedRanges.end()) {
+      std::vector<Vertex> meshVertices(vertices.begin() + submesh.vertexOffset,
+                                       vertices.begin() + submesh.vertexOffset +
+                                           submesh.vertexCount);
+      std::vector<uint32_t> meshIndices(indices.begin() + submesh.firstIndex,
+                                        indices.begin() + submesh.firstIndex + submesh.indexCount);
+
+      before += LveMeshOptimizer::analyzeVertexCache(meshIndices, meshVertices.size());
+      LveMeshOptimizer::optimize(meshVertices, meshIndices);
+      after += LveMeshOptimizer::analyzeVertexCache(meshIndices, meshVertices.size());
+
+      Submesh range{};
+      range.firstIndex = static_cast<uint32_t>(optimizedIndices.size());
+      range.indexCount = static_cast<uint32_t>(meshIndices.size());
+      range.vertexOffset = static_cast<int32_t>(optimizedVertices.size());
+      range.vertexCount = static_cast<uint32_t>(meshVertices.size());
+      optimizedVertices.insert(optimizedVertices.end(), meshVertices.begin(), meshVertices.end());
+      optimizedIndices.insert(optimizedIndices.end(), meshIndices.begin(), meshIndices.end());
+      it = optimizedRanges.emplace(key, range).first;
+    }
+
+    submesh.firstIndex = it->second.firstIndex;
+    submesh.indexCount = it->second.indexCount;
+    submesh.vertexOffset = it->second.vertexOffset;
+    submesh.vertexCount = it->second.vertexCount;
+  }
+
+  fmt::println("optimized mesh: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+               vertices.size(), optimizedVertices.size(), before.acmr(), after.acmr(),
+               before.atvr(), after.atvr());
+
+  vertices = std::move(optimizedVertices);
+  indices = std::move(optimizedIndices);
+}
+
+/**
+ * Every level halves the triangle count of LOD 0, as long as the simplified surface stays within
+ * LOD_ERROR_LIMIT of a mesh's extent. Levels are simplified from LOD 0 rather than from each other
+ * so their errors don't accumulate
+ */
+void LveModel::Builder::generateLods() {
+  constexpr float LOD_ERROR_LIMIT = 0.05f;
+  // levels that barely reduce the triangle count aren't worth drawing
+  constexpr float LOD_MIN_REDUCTION = 0.9f;
+
+  if (submeshes.empty()) {
+    submeshes.push_back({0, static_cast<uint32_t>(indices.size()), 0,
+                         static_cast<uint32_t>(vertices.size()), glm::mat4{1.f}});
+  }
+  const auto baseSubmeshCount = static_cast<uint32_t>(submeshes.size());
+  lods.assign(1, {0, baseSubmeshCount, 0.f});
+
+  // the current level of every mesh range, shared by the submeshes instancing it
+  struct RangeLod {
+    Submesh base;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+  };
+  std::map<std::pair<uint32_t, int32_t>, RangeLod> ranges{};
+  for (uint32_t i = 0; i < baseSubmeshCount; i++) {
+    const auto& submesh = submeshes[i];
+    ranges.emplace(std::make_pair(submesh.firstIndex, submesh.vertexOffset),
+                   RangeLod{submesh, submesh.firstIndex, submesh.indexCount, 0.f});
+  }
+
+  for (uint32_t level = 1; level < MAX_LODS; level++) {
+    bool reduced = false;
+    float levelError = 0.f;
+    for (auto& [key, range] : ranges) {
+      const auto& base = range.base;
+      std::vector<Vertex> meshVertices(vertices.begin() + base.vertexOffset,
+                                       vertices.begin() + base.vertexOffset + base.vertexCount);
+      std::vector<uint32_t> meshIndices(indices.begin() + base.firstIndex,
+                                        indices.begin() + base.firstIndex + base.indexCount);
+
+      glm::vec3 extentMin{std::numeric_limits<float>::max()};
+      glm::vec3 extentMax{std::numeric_limits<float>::lowest()};
+      for (const auto& vertex : meshVertices) {
+        extentMin = glm::min(extentMin, vertex.position);
+        extentMax = glm::max(extentMax, vertex.position);
+      }
+      float errorLimit = LOD_ERROR_LIMIT * glm::length(extentMax - extentMin);
+
+      size_t targetIndexCount = (base.indexCount >> level) / 3 * 3;
+      float error = 0.f;
+      std::vector<uint32_t> simplified = LveMeshSimplifier::simplify(
+          meshVertices, meshIndices, targetIndexCount, errorLimit, error);
+
+      if (!simplified.empty() &&
+          static_cast<float>(simplified.size()) < LOD_MIN_REDUCTION * range.indexCount) {
+        LveMeshOptimizer::optimizeVertexCache(simplified, meshVertices.size());
+        range.firstIndex = static_cast<uint32_t>(indices.size());
+        range.indexCount = static_cast<uint32_t>(simplified.size());
+        range.error = error;
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        reduced = true;
+      }
+      levelError = std::max(levelError, range.error);
+    }
+
+    if (!reduced) {
+      break;
+    }
+
+    lods.push_back({static_cast<uint32_t>(submeshes.size()), baseSubmeshCount, levelError});
+    for (uint32_t i = 0; i < baseSubmeshCount; i++) {
+      Submesh submesh = submeshes[i];
+      const auto& range = ranges.at(std::make_pair(submesh.firstIndex, submesh.vertexOffset));
+      submesh.firstIndex = range.firstIndex;
+      submesh.indexCount = range.indexCount;
+      submeshes.push_back(submesh);
+    }
+  }
+}
+
+void LveModel::Builder::buildMeshlets() {
+  meshlets.clear();
+
+  // submeshes sharing a range share its meshlets as well
+  std::map<std::pair<uint32_t, int32_t>, std::pair<uint32_t, uint32_t>> rangeMeshlets{};
+  for (auto& submesh : submeshes) {
+    auto key = std::make_pair(submesh.firstIndex, submesh.vertexOffset);
+    auto it = rangeMeshlets.find(key);
+    if (it == rangeMeshlets.end()) {
+      std::vector<Vertex> meshVertices(vertices.begin() + submesh.vertexOffset,
+                                       vertices.begin() + submesh.vertexOffset +
+                                           submesh.vertexCount);
+      std::vector<uint32_t> meshIndices(indices.begin() + submesh.firstIndex,
+                                        indices.begin() + submesh.firstIndex + submesh.indexCount);
+      auto meshMeshlets = LveMeshOptimizer::buildMeshlets(meshVertices, meshIndices);
+
+      auto range = std::make_pair(static_cast<uint32_t>(meshlets.size()),
+                                  static_cast<uint32_t>(meshMeshlets.size()));
+      meshlets.insert(meshlets.end(), meshMeshlets.begin(), meshMeshlets.end());
+      it = rangeMeshlets.emplace(key, range).first;
+    }
+    submesh.firstMeshlet = it->second.first;
+    submesh.meshletCount = it->second.second;
+  }
+}
+
+// bounds of the model in its own space, with the node transforms of every submesh applied
+void LveModel::Builder::computeBounds() {
+  boundsMin = glm::vec3{std::numeric_limits<float>::max()};
+  boundsMax = glm::vec3{std::numeric_limits<float>::lowest()};
+
+  auto addSubmesh = [&](const Submesh& submesh) {
+    for (uint32_t i = 0; i < submesh.vertexCount; i++) {
+      const auto& position = vertices[submesh.vertexOffset + i].position;
+      glm::vec3 p = glm::vec3(submesh.transform * glm::vec4(position, 1.f));
+      boundsMin = glm::min(boundsMin, p);
+      boundsMax = glm::max(boundsMax, p);
+    }
+  };
+
+  // every level of detail covers the same vertices, the first one is enough
+  uint32_t submeshCount = lods.empty() ? static_cast<uint32_t>(submeshes.size())
+                                       : lods[0].submeshCount;
+  if (submeshCount == 0) {
+    addSubmesh({0, static_cast<uint32_t>(indices.size()), 0,
+                static_cast<uint32_t>(vertices.size()), glm::mat4{1.f}});
+  }
+  for (uint32_t i = 0; i < submeshCount; i++) {
+    addSubmesh(submeshes[i]);
+  }
+
+  if (boundsMin.x > boundsMax.x) {
+    boundsMin = boundsMax = glm::vec3{0.f};
+  }
+}
+
+void LveModel::Builder::packVertices() {
+  packedPositions.clear();
+  packedAttributes.clear();
+  if (vertices.empty()) {
+    return;
+  }
+
+  // the position range is taken from the vertices as stored, submesh transforms are applied later
+  glm::vec3 positionMin = vertices[0].position;
+  glm::vec3 positionMax = vertices[0].position;
+  for (const auto& vertex : vertices) {
+    positionMin = glm::min(positionMin, vertex.position);
+    positionMax = glm::max(positionMax, vertex.position);
+  }
+  positionOffset = positionMin;
+  positionScale = positionMax - positionMin;
+  glm::vec3 quantizationScale{};
+  for (int axis = 0; axis < 3; axis++) {
+    // flat models would divide by zero
+    quantizationScale[axis] = positionScale[axis] > 0.f ? 1.f / positionScale[axis] : 0.f;
+  }
+
+  packedPositions.resize(vertices.size());
+  packedAttributes.resize(vertices.size());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const auto& vertex = vertices[i];
+    glm::vec3 position = (vertex.position - positionOffset) * quantizationScale;
+    for (int axis = 0; axis < 3; axis++) {
+      packedPositions[i].position[axis] = glm::packUnorm1x16(position[axis]);
+    }
+    // the fourth component is padding, set so no indeterminate bytes are cooked or uploaded
+    packedPositions[i].position[3] = 0;
+
+    auto& attributes = packedAttributes[i];
+    glm::vec2 normal = octahedralEncode(vertex.normal);
+    attributes.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+    attributes.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+    attributes.uv[0] = glm::packHalf1x16(vertex.uv.x);
+    attributes.uv[1] = glm::packHalf1x16(vertex.uv.y);
+    uint32_t color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.f));
+    std::memcpy(attributes.color, &color, sizeof(color));
+  }
+}
+
+LveModel::MeshData LveModel::Builder::data() const {
+  MeshData data{};
+  data.vertices = vertices.data();
+  data.vertexCount = static_cast<uint32_t>(vertices.size());
+  data.indices = indices.data();
+  data.indexCount = static_cast<uint32_t>(indices.size());
+  data.submeshes = submeshes.data();
+  data.submeshCount = static_cast<uint32_t>(submeshes.size());
+  data.lods = lods.data();
+  data.lodCount = static_cast<uint32_t>(lods.size());
+  data.meshlets = meshlets.data();
+  data.meshletCount = static_cast<uint32_t>(meshlets.size());
+  data.boundsMin = boundsMin;
+  data.boundsMax = boundsMax;
+  if (packedPositions.size() == vertices.size()) {
+    data.packedPositions = packedPositions.data();
+    data.packedAttributes = packedAttributes.data();
+    data.positionOffset = positionOffset;
+    data.positionScale = positionScale;
+  }
+  return data;
+}
+} // namespace lve
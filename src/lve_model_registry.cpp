@@ -0,0 +1,279 @@
+#include "lve_model_registry.h"
+#include "rendering/lve_deletion_queue.h"
+#include "rendering/lve_swapchain.h"
+#include <fmt/core.h>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+namespace lve {
+
+LveModelRegistry::LveModelRegistry(LveDevice& device, LveThreadPool& threadPool,
+                                   VkDeviceSize memoryCap)
+    : lveDevice{device}, threadPool{threadPool}, memoryCap{memoryCap} {}
+
+// "./assets/a.obj" and "assets/../assets/a.obj" name the same model
+LveModelRegistry::Key LveModelRegistry::makeKey(const std::string& filepath,
+                                                LveModel::VertexFormat format) {
+  return {std::filesystem::path(filepath).lexically_normal().generic_string(), format};
+}
+
+std::shared_ptr<LveModel> LveModelRegistry::get(const std::string& filepath,
+                                                LveModel::VertexFormat format) {
+  return getAll({filepath}, format)[0];
+}
+
+std::vector<std::shared_ptr<LveModel>> LveModelRegistry::getAll(
+    const std::vector<std::string>& filepaths, LveModel::VertexFormat format) {
+  std::vector<Key> keys{};
+  keys.reserve(filepaths.size());
+  std::vector<std::string> missing{};
+  for (const auto& filepath : filepaths) {
+    keys.push_back(makeKey(filepath, format));
+    auto entry = entries.find(keys.back());
+    if (entry != entries.end()) {
+      // making room for the missing models must not evict the ones requested with them
+      entry->second.lastUsedFrame = frame;
+    } else if (std::find(missing.begin(), missing.end(), keys.back().filepath) == missing.end()) {
+      missing.push_back(keys.back().filepath);
+    }
+  }
+
+  if (!missing.empty()) {
+    // every worker job runs its own Assimp importer, they share no state
+    std::vector<std::future<std::unique_ptr<LveMeshSource>>> sources{};
+    sources.reserve(missing.size());
+    for (const auto& filepath : missing) {
+      sources.push_back(threadPool.submit([filepath]() { return LveMeshSource::load(filepath); }));
+    }
+
+    // models are created on this thread as results come in, the copies go out together at the end
+    LveUploadBatch batch{lveDevice};
+    for (size_t i = 0; i < missing.size(); i++) {
+      auto model = createModel(*sources[i].get(), format, batch);
+      memoryUsage += model->getMemorySize();
+      entries.emplace(Key{missing[i], format}, Entry{std::move(model), frame});
+    }
+    batch.submit();
+  }
+
+  std::vector<std::shared_ptr<LveModel>> result{};
+  result.reserve(keys.size());
+  for (const auto& key : keys) {
+    result.push_back(entries.at(key).model);
+  }
+
+  // the requested models are referenced by result and can't be evicted
+  if (memoryUsage > memoryCap) {
+    evict(memoryCap);
+  }
+  return result;
+}
+
+std::shared_ptr<const LveModelStream> LveModelRegistry::request(const std::string& filepath,
+                                                               LveModel::VertexFormat format) {
+  Key key = makeKey(filepath, format);
+  auto stream = std::make_shared<LveModelStream>();
+
+  auto entry = entries.find(key);
+  if (entry != entries.end()) {
+    entry->second.lastUsedFrame = frame;
+    stream->model = entry->second.model;
+    return stream;
+  }
+
+  // reloads have no stream, a key evicted while its reload is pending is loaded anew
+  for (const auto& pendingStream : pending) {
+    if (pendingStream.key == key && pendingStream.stream != nullptr) {
+      return pendingStream.stream;
+    }
+  }
+
+  auto source =
+      threadPool.submit([path = key.filepath]() { return LveMeshSource::load(path); });
+  pending.push_back({std::move(key), std::move(source), stream});
+  return stream;
+}
+
+void LveModelRegistry::reload(const std::string& filepath) {
+  std::string sourcePath = makeKey(filepath, LveModel::VertexFormat::Packed).filepath;
+  std::string cookedSuffix = LveMeshFile::cookedPathFor("");
+  if (sourcePath.size() > cookedSuffix.size() &&
+      sourcePath.compare(sourcePath.size() - cookedSuffix.size(), cookedSuffix.size(),
+                         cookedSuffix) == 0) {
+    sourcePath.resize(sourcePath.size() - cookedSuffix.size());
+  }
+
+  for (const auto& [key, entry] : entries) {
+    if (key.filepath == sourcePath) {
+      auto source =
+          threadPool.submit([sourcePath]() { return LveMeshSource::load(sourcePath); });
+      pending.push_back({key, std::move(source), nullptr});
+    }
+  }
+}
+
+/**
+ * Creates a model whose uploads are recorded into batch. If the geometry arena is full, unused
+ * models are evicted and the model is created once more
+ *
+ * @return The model, throws if it doesn't fit into the arena even then
+ */
+std::shared_ptr<LveModel> LveModelRegistry::createModel(const LveMeshSource& source,
+                                                        LveModel::VertexFormat format,
+                                                        LveUploadBatch& batch) {
+  try {
+    return std::make_shared<LveModel>(lveDevice, source.data(), batch, format);
+  } catch (const std::runtime_error& e) {
+    fmt::println("{}, evicting unused models", e.what());
+  }
+
+  // evicted geometry is freed through the deletion queue, which can run right away once the
+  // device is idle. Models created into batch are referenced and stay
+  evict(0);
+  lveDevice.waitIdle();
+  lveDevice.deletionQueue().flush();
+  return std::make_shared<LveModel>(lveDevice, source.data(), batch, format);
+}
+
+/**
+ * Creates the models of parsed requests in request order until the frame's upload budget is used
+ * up, a model that is still being parsed holds back the ones requested after it
+ */
+void LveModelRegistry::createStreamedModels() {
+  if (pending.empty()) {
+    return;
+  }
+
+  LveUploadBatch batch{lveDevice};
+  VkDeviceSize uploaded = 0;
+  size_t done = 0;
+  for (; done < pending.size() && uploaded < uploadBudget; done++) {
+    auto& pendingStream = pending[done];
+    if (pendingStream.source.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+      break;
+    }
+
+    // a blocking get may have loaded the model in the meantime
+    auto entry = entries.find(pendingStream.key);
+    if (pendingStream.stream != nullptr && entry != entries.end()) {
+      pendingStream.stream->model = entry->second.model;
+      uploading.push_back(entry->second.model);
+      continue;
+    }
+
+    std::unique_ptr<LveMeshSource> source{};
+    try {
+      source = pendingStream.source.get();
+    } catch (const std::exception& e) {
+      // a failed reload keeps the old model
+      fmt::println("failed to load {}: {}", pendingStream.key.filepath, e.what());
+      if (pendingStream.stream != nullptr) {
+        pendingStream.stream->failed = true;
+      }
+      continue;
+    }
+
+    std::shared_ptr<LveModel> model{};
+    try {
+      model = createModel(*source, pendingStream.key.format, batch);
+    } catch (const std::exception& e) {
+      fmt::println("failed to create {}: {}", pendingStream.key.filepath, e.what());
+      if (pendingStream.stream != nullptr) {
+        pendingStream.stream->failed = true;
+      }
+      continue;
+    }
+    uploaded += model->getMemorySize();
+    if (pendingStream.stream == nullptr) {
+      reloads.push_back({pendingStream.key, std::move(model)});
+      continue;
+    }
+    memoryUsage += model->getMemorySize();
+    entries.emplace(pendingStream.key, Entry{model, frame});
+    uploading.push_back(model);
+    pendingStream.stream->model = std::move(model);
+  }
+  batch.submit();
+
+  pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(done));
+}
+
+/**
+ * Moves the geometry of resident reloads into the models they replace, the old geometry is
+ * released once the frames in flight are done with it
+ */
+void LveModelRegistry::swapReloadedModels() {
+  for (auto it = reloads.begin(); it != reloads.end();) {
+    if (!it->model->isResident()) {
+      ++it;
+      continue;
+    }
+
+    // an evicted model is simply not replaced
+    auto entry = entries.find(it->key);
+    if (entry != entries.end()) {
+      memoryUsage -= entry->second.model->getMemorySize();
+      entry->second.model->swapGeometry(*it->model);
+      memoryUsage += entry->second.model->getMemorySize();
+    }
+    // the old geometry now belongs to the reload, its destructor defers freeing it
+    it = reloads.erase(it);
+  }
+}
+
+// drops streamed models whose upload completed, or that were evicted before it did
+void LveModelRegistry::collectResidentModels() {
+  uploading.erase(std::remove_if(uploading.begin(), uploading.end(),
+                                 [](const std::weak_ptr<LveModel>& weak) {
+                                   auto model = weak.lock();
+                                   return model == nullptr || model->isResident();
+                                 }),
+                  uploading.end());
+}
+
+void LveModelRegistry::beginFrame() {
+  frame++;
+  createStreamedModels();
+  swapReloadedModels();
+  collectResidentModels();
+  for (auto& [key, entry] : entries) {
+    if (entry.model.use_count() > 1) {
+      entry.lastUsedFrame = frame;
+    }
+  }
+
+  if (memoryUsage > memoryCap) {
+    evict(memoryCap);
+  }
+}
+
+VkDeviceSize LveModelRegistry::evict(VkDeviceSize targetBytes) {
+  std::vector<std::map<Key, Entry>::iterator> candidates{};
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    // frames still in flight may draw models that were dropped only recently
+    if (it->second.model.use_count() == 1 &&
+        it->second.lastUsedFrame + LveSwapchain::MAX_FRAMES_IN_FLIGHT < frame) {
+      candidates.push_back(it);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+    return a->second.lastUsedFrame < b->second.lastUsedFrame;
+  });
+
+  VkDeviceSize released = 0;
+  for (auto it : candidates) {
+    if (memoryUsage <= targetBytes) {
+      break;
+    }
+    VkDeviceSize size = it->second.model->getMemorySize();
+    entries.erase(it);
+    memoryUsage -= size;
+    released += size;
+  }
+  return released;
+}
+
+} // namespace lve
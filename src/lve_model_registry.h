@@ -0,0 +1,144 @@
+#pragma once
+
+#include "lve_mesh_file.h"
+#include "lve_model.h"
+#include "lve_thread_pool.h"
+
+// std
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Cache of the models loaded from files, keyed by their normalized path and vertex format.
+ *
+ * Every request for an asset that is already loaded returns the same shared model, requests in
+ * one call are parsed in parallel and every asset in them is loaded once. The registry holds a
+ * reference of its own, models nobody else holds any more stay cached until the geometry of all
+ * models exceeds the memory cap. Those are then evicted least recently used first.
+ *
+ * A model counts as used in every frame in which something besides the registry references it.
+ * It is only evicted after it hasn't been used for MAX_FRAMES_IN_FLIGHT frames, so no frame the
+ * GPU may still be working on draws it. Call from the main thread only.
+ *
+ * If the geometry arena is full when a model is created, unused models are evicted and the model
+ * is created once more. Their geometry is freed right away, which waits for the device to go
+ * idle, so get/getAll must not be called while a frame is being recorded. The registry doesn't
+ * handle the device's memory budget: the arena's buffers keep their memory either way.
+ *
+ * get/getAll block until their models are loaded. request streams a model in instead: the file is
+ * parsed on the thread pool and beginFrame creates parsed models only as long as the frame's
+ * upload budget lasts, so streaming in a scene is spread over many frames. A single model larger
+ * than the budget still goes out within one frame. Reloads go through the same budget.
+ */
+class LveModelRegistry {
+public:
+  static constexpr VkDeviceSize DEFAULT_MEMORY_CAP = 64ull * 1024 * 1024;
+  static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 4ull * 1024 * 1024;
+
+  LveModelRegistry(LveDevice& device, LveThreadPool& threadPool,
+                   VkDeviceSize memoryCap = DEFAULT_MEMORY_CAP);
+
+  LveModelRegistry(const LveModelRegistry&) = delete;
+  LveModelRegistry& operator=(const LveModelRegistry&) = delete;
+
+  std::shared_ptr<LveModel> get(const std::string& filepath,
+                                LveModel::VertexFormat format = LveModel::VertexFormat::Packed);
+  // parses the missing models in parallel on the pool, their uploads share one batched submission.
+  // Models are returned in the order of filepaths
+  std::vector<std::shared_ptr<LveModel>> getAll(
+      const std::vector<std::string>& filepaths,
+      LveModel::VertexFormat format = LveModel::VertexFormat::Packed);
+
+  // returns right away, requests for a model that is already streaming share its stream
+  std::shared_ptr<const LveModelStream> request(
+      const std::string& filepath,
+      LveModel::VertexFormat format = LveModel::VertexFormat::Packed);
+
+  // re-imports every loaded model of filepath, or of the source a cooked .lvemesh belongs to, in
+  // the background. Reloaded models take the place of the old ones once they are resident, the
+  // LveModel objects stay the same
+  void reload(const std::string& filepath);
+
+  // call once per recorded frame before recording it: advances the frame counter, creates the
+  // streamed models that fit into the upload budget, records which models are in use and evicts
+  // if usage is over the cap
+  void beginFrame();
+
+  /**
+   * Evicts unused models, least recently used first, until usage is at most targetBytes
+   *
+   * @return Geometry bytes released
+   */
+  VkDeviceSize evict(VkDeviceSize targetBytes);
+
+  void setMemoryCap(VkDeviceSize memoryCap) { this->memoryCap = memoryCap; }
+  [[nodiscard]] VkDeviceSize getMemoryCap() const { return memoryCap; }
+  // geometry bytes uploaded for streamed models per frame
+  void setUploadBudget(VkDeviceSize bytesPerFrame) { uploadBudget = bytesPerFrame; }
+  // true while requested or reloaded models are still being parsed, created or uploaded, as of the
+  // last beginFrame
+  [[nodiscard]] bool isStreaming() const {
+    return !pending.empty() || !uploading.empty() || !reloads.empty();
+  }
+  [[nodiscard]] VkDeviceSize getMemoryUsage() const { return memoryUsage; }
+  [[nodiscard]] size_t getModelCount() const { return entries.size(); }
+
+private:
+  struct Key {
+    std::string filepath;
+    LveModel::VertexFormat format;
+
+    bool operator==(const Key& other) const {
+      return filepath == other.filepath && format == other.format;
+    }
+    bool operator<(const Key& other) const {
+      return filepath != other.filepath ? filepath < other.filepath : format < other.format;
+    }
+  };
+
+  struct Entry {
+    std::shared_ptr<LveModel> model;
+    uint64_t lastUsedFrame;
+  };
+
+  struct PendingStream {
+    Key key;
+    std::future<std::unique_ptr<LveMeshSource>> source;
+    // null for reloads
+    std::shared_ptr<LveModelStream> stream;
+  };
+
+  struct Reload {
+    Key key;
+    std::shared_ptr<LveModel> model;
+  };
+
+  std::shared_ptr<LveModel> createModel(const LveMeshSource& source,
+                                        LveModel::VertexFormat format, LveUploadBatch& batch);
+  void createStreamedModels();
+  void swapReloadedModels();
+  void collectResidentModels();
+
+  static Key makeKey(const std::string& filepath, LveModel::VertexFormat format);
+
+  LveDevice& lveDevice;
+  LveThreadPool& threadPool;
+  VkDeviceSize memoryCap;
+  VkDeviceSize memoryUsage = 0;
+  VkDeviceSize uploadBudget = DEFAULT_UPLOAD_BUDGET;
+  uint64_t frame = 0;
+  std::map<Key, Entry> entries{};
+  // in request order
+  std::vector<PendingStream> pending{};
+  // created but not resident yet
+  std::vector<Reload> reloads{};
+  // streamed models created but not resident yet, weak so waiting doesn't count as use
+  std::vector<std::weak_ptr<LveModel>> uploading{};
+};
+
+} // namespace lve
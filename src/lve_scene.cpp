@@ -0,0 +1,290 @@
+#include "lve_scene.h"
+#include "lve_transform_batch.h"
+
+// std
+#include <cassert>
+
+namespace lve {
+
+// the caller has to hold the mutex
+LveGameObject LveScene::allocateSlot() {
+  if (!freeSlots.empty()) {
+    uint32_t index = freeSlots.back();
+    freeSlots.pop_back();
+    return {index, generations[index]};
+  }
+
+  generations.push_back(0);
+  return {static_cast<uint32_t>(generations.size() - 1), 0};
+}
+
+LveGameObject LveScene::createGameObject() {
+  LveGameObject gameObject{};
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    gameObject = allocateSlot();
+  }
+  transformPool.emplace(gameObject.index);
+  dirtyTransforms.push_back(gameObject.index);
+  return gameObject;
+}
+
+LveGameObject LveScene::reserveGameObject() {
+  std::lock_guard<std::mutex> lock{mutex};
+  LveGameObject gameObject = allocateSlot();
+  reserved.push_back(gameObject);
+  return gameObject;
+}
+
+void LveScene::destroyGameObject(LveGameObject gameObject) {
+  std::lock_guard<std::mutex> lock{mutex};
+  if (gameObject.index < generations.size() &&
+      generations[gameObject.index] == gameObject.generation) {
+    destroyed.push_back(gameObject);
+  }
+}
+
+bool LveScene::isAlive(LveGameObject gameObject) const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return gameObject.index < generations.size() &&
+         generations[gameObject.index] == gameObject.generation;
+}
+
+void LveScene::beginFrame() {
+  std::vector<LveGameObject> newGameObjects{};
+  std::vector<LveGameObject> oldGameObjects{};
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    newGameObjects.swap(reserved);
+    oldGameObjects.swap(destroyed);
+  }
+
+  for (auto gameObject : newGameObjects) {
+    transformPool.emplace(gameObject.index);
+    dirtyTransforms.push_back(gameObject.index);
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+  for (auto gameObject : oldGameObjects) {
+    // destroyed twice in the same frame, or already destroyed along with a parent
+    if (generations[gameObject.index] != gameObject.generation) {
+      continue;
+    }
+    detach(gameObject.index);
+
+    subtree.push_back(gameObject.index);
+    while (!subtree.empty()) {
+      uint32_t index = subtree.back();
+      subtree.pop_back();
+      for (uint32_t child = transformPool.get(index).firstChild;
+           child != TransformComponent::NO_LINK; child = transformPool.get(child).nextSibling) {
+        subtree.push_back(child);
+      }
+
+      generations[index]++;
+      freeSlots.push_back(index);
+      transformPool.remove(index);
+      models.remove(index);
+      pointLights.remove(index);
+    }
+  }
+}
+
+void LveScene::setParent(LveGameObject child, LveGameObject parent) {
+  assert(isAlive(child) && isAlive(parent) && "Cannot parent destroyed game objects");
+  for (uint32_t ancestor = parent.index; ancestor != TransformComponent::NO_LINK;
+       ancestor = transformPool.get(ancestor).parent) {
+    assert(ancestor != child.index && "Cannot parent a game object to its own descendant");
+  }
+
+  detach(child.index);
+  auto& childTransform = transformPool.get(child.index);
+  auto& parentTransform = transformPool.get(parent.index);
+  childTransform.parent = parent.index;
+  childTransform.nextSibling = parentTransform.firstChild;
+  if (parentTransform.firstChild != TransformComponent::NO_LINK) {
+    transformPool.get(parentTransform.firstChild).previousSibling = child.index;
+  }
+  parentTransform.firstChild = child.index;
+
+  updateDepths(child.index);
+  markTransformDirty(child.index);
+}
+
+void LveScene::removeParent(LveGameObject child) {
+  assert(isAlive(child) && "Cannot unparent a destroyed game object");
+  detach(child.index);
+  updateDepths(child.index);
+  markTransformDirty(child.index);
+}
+
+TransformComponent& LveScene::editTransform(LveGameObject gameObject) {
+  assert(isAlive(gameObject) && "Cannot edit the transform of a destroyed game object");
+  return editTransform(gameObject.index);
+}
+
+TransformComponent& LveScene::editTransform(uint32_t id) {
+  markTransformDirty(id);
+  return transformPool.get(id);
+}
+
+void LveScene::markTransformDirty(uint32_t index) {
+  auto& transform = transformPool.get(index);
+  if (!transform.localDirty) {
+    transform.localDirty = true;
+    dirtyTransforms.push_back(index);
+  }
+}
+
+void LveScene::updateTransforms() {
+  if (dirtyTransforms.empty()) {
+    return;
+  }
+
+  // the local matrices are composed from a structure of arrays, in one batch per rotation mode
+  batchedTransforms.clear();
+  for (auto mode :
+       {TransformComponent::RotationMode::Euler, TransformComponent::RotationMode::Quaternion}) {
+    for (uint32_t index : dirtyTransforms) {
+      // destroyed since, or a slot that was reused and is listed twice
+      auto* transform = transformPool.find(index);
+      if (transform == nullptr || !transform->localDirty || transform->rotationMode != mode) {
+        continue;
+      }
+      transform->localDirty = false;
+      batchedTransforms.push_back(index);
+    }
+  }
+  size_t count = batchedTransforms.size();
+  size_t eulerCount = 0;
+
+  for (auto& array : transformArrays) {
+    array.resize(count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    const auto& transform = transformPool.get(batchedTransforms[i]);
+    if (transform.rotationMode == TransformComponent::RotationMode::Euler) {
+      eulerCount++;
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      transformArrays[axis][i] = transform.translation[axis];
+      transformArrays[3 + axis][i] = transform.rotation[axis];
+      transformArrays[6 + axis][i] = transform.scale[axis];
+    }
+    transformArrays[9][i] = transform.orientation.x;
+    transformArrays[10][i] = transform.orientation.y;
+    transformArrays[11][i] = transform.orientation.z;
+    transformArrays[12][i] = transform.orientation.w;
+  }
+
+  localMatrices.resize(count);
+  localNormalMatrices.resize(count);
+  auto input = [&](size_t first) {
+    auto array = [&](int component) { return transformArrays[component].data() + first; };
+    return LveTransformBatch::Input{{array(0), array(1), array(2)},
+                                    {array(3), array(4), array(5)},
+                                    {array(6), array(7), array(8)},
+                                    {array(9), array(10), array(11), array(12)}};
+  };
+  LveTransformBatch::compose(input(0), eulerCount, localMatrices.data(),
+                             localNormalMatrices.data());
+  LveTransformBatch::composeQuaternions(input(eulerCount), count - eulerCount,
+                                        localMatrices.data() + eulerCount,
+                                        localNormalMatrices.data() + eulerCount);
+
+  for (size_t i = 0; i < count; i++) {
+    auto& transform = transformPool.get(batchedTransforms[i]);
+    transform.localMatrix = localMatrices[i];
+    transform.localNormalMatrix = glm::mat3{localNormalMatrices[i]};
+    queueWorldUpdates(batchedTransforms[i]);
+  }
+  dirtyTransforms.clear();
+
+  // a level only depends on the one above it
+  for (auto& level : worldUpdates) {
+    for (uint32_t index : level) {
+      auto& transform = transformPool.get(index);
+      if (transform.parent == TransformComponent::NO_LINK) {
+        transform.worldMatrix = transform.localMatrix;
+        transform.worldNormalMatrix = transform.localNormalMatrix;
+      } else {
+        // the inverse transpose of a product is the product of the inverse transposes
+        const auto& parent = transformPool.get(transform.parent);
+        transform.worldMatrix = parent.worldMatrix * transform.localMatrix;
+        transform.worldNormalMatrix = parent.worldNormalMatrix * transform.localNormalMatrix;
+      }
+      transform.worldDirty = false;
+    }
+    level.clear();
+  }
+}
+
+// unlinks the game object from its parent and siblings, its children stay attached to it
+void LveScene::detach(uint32_t index) {
+  auto& transform = transformPool.get(index);
+  if (transform.parent == TransformComponent::NO_LINK) {
+    return;
+  }
+
+  auto& parent = transformPool.get(transform.parent);
+  if (parent.firstChild == index) {
+    parent.firstChild = transform.nextSibling;
+  }
+  if (transform.previousSibling != TransformComponent::NO_LINK) {
+    transformPool.get(transform.previousSibling).nextSibling = transform.nextSibling;
+  }
+  if (transform.nextSibling != TransformComponent::NO_LINK) {
+    transformPool.get(transform.nextSibling).previousSibling = transform.previousSibling;
+  }
+  transform.parent = TransformComponent::NO_LINK;
+  transform.previousSibling = TransformComponent::NO_LINK;
+  transform.nextSibling = TransformComponent::NO_LINK;
+}
+
+void LveScene::updateDepths(uint32_t index) {
+  subtree.push_back(index);
+  while (!subtree.empty()) {
+    auto& transform = transformPool.get(subtree.back());
+    subtree.pop_back();
+    transform.depth = transform.parent == TransformComponent::NO_LINK
+                          ? 0
+                          : transformPool.get(transform.parent).depth + 1;
+    for (uint32_t child = transform.firstChild; child != TransformComponent::NO_LINK;
+         child = transformPool.get(child).nextSibling) {
+      subtree.push_back(child);
+    }
+  }
+}
+
+// queues the world matrices of the game object and all of its descendants
+void LveScene::queueWorldUpdates(uint32_t index) {
+  subtree.push_back(index);
+  while (!subtree.empty()) {
+    uint32_t current = subtree.back();
+    subtree.pop_back();
+    auto& transform = transformPool.get(current);
+    // queued along with an ancestor, and so was everything below it
+    if (transform.worldDirty) {
+      continue;
+    }
+    transform.worldDirty = true;
+
+    if (transform.depth >= worldUpdates.size()) {
+      worldUpdates.resize(transform.depth + 1);
+    }
+    worldUpdates[transform.depth].push_back(current);
+    for (uint32_t child = transform.firstChild; child != TransformComponent::NO_LINK;
+         child = transformPool.get(child).nextSibling) {
+      subtree.push_back(child);
+    }
+  }
+}
+
+LveGameObject LveScene::makePointLight(float intensity, float radius, glm::vec3 color) {
+  LveGameObject gameObject = createGameObject();
+  editTransform(gameObject).scale.x = radius;
+  emplace<PointLightComponent>(gameObject, intensity, color);
+  return gameObject;
+}
+
+} // namespace lve
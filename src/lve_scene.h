@@ -0,0 +1,173 @@
+#pragma once
+
+#include "lve_component_pool.h"
+#include "lve_game_object.h"
+
+// std
+#include <cassert>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Game objects and their components.
+ *
+ * A game object is only a handle, its data lives in one LveComponentPool per component type keyed
+ * by the handle's index. Systems iterate the pool of the component they are interested in and look
+ * up further components of the same game object by the ids the pool lists, so they never touch
+ * game objects that don't concern them. Everything else goes through find, get, emplace and
+ * remove, which check the handle's generation, so a stale handle never reaches the component of
+ * whichever game object reuses its slot.
+ *
+ * Slots of destroyed game objects are kept on a free list and reused, which keeps the pools' index
+ * tables as small as the largest number of game objects alive at once. Every reuse bumps the
+ * slot's generation, so handles of destroyed game objects are recognized by isAlive.
+ *
+ * Handles can be reserved and destroyed from any thread. Components are only touched by the main
+ * thread though: reserved game objects get their transform and destroyed ones lose their
+ * components in beginFrame. Until then a destroyed game object is still alive. Destroying a game
+ * object destroys its children as well.
+ *
+ * Game objects can be parented to each other, a transform is then relative to its parent's.
+ * Transforms cache their local and world matrices. They are only handed out for writing through
+ * editTransform, which marks them dirty, and updateTransforms recomputes only the dirty transforms
+ * and the world matrices below them, parents before children. A frame in which nothing moved
+ * costs no transform math at all.
+ */
+class LveScene {
+public:
+  LveScene() = default;
+
+  LveScene(const LveScene&) = delete;
+  LveScene& operator=(const LveScene&) = delete;
+
+  // every game object has a transform. Main thread only, the transform can be set right away
+  LveGameObject createGameObject();
+  // thread safe, the game object gets its transform in the next beginFrame
+  LveGameObject reserveGameObject();
+  // thread safe, stale handles are ignored
+  void destroyGameObject(LveGameObject gameObject);
+  // thread safe
+  [[nodiscard]] bool isAlive(LveGameObject gameObject) const;
+
+  // call once per frame on the main thread, applies reservations and destructions
+  void beginFrame();
+
+  // child keeps its transform, which becomes relative to parent
+  void setParent(LveGameObject child, LveGameObject parent);
+  void removeParent(LveGameObject child);
+  [[nodiscard]] bool hasParent(LveGameObject gameObject) const {
+    return get<TransformComponent>(gameObject).parent != TransformComponent::NO_LINK;
+  }
+
+  // transforms are handed out read only, see editTransform
+  template <typename T>
+  using Access = std::conditional_t<std::is_same_v<T, TransformComponent>, const T, T>;
+
+  // nullptr if the handle is stale or the game object has no component of type T
+  template <typename T>
+  Access<T>* find(LveGameObject gameObject) {
+    return isAlive(gameObject) ? pool<T>().find(gameObject.index) : nullptr;
+  }
+  template <typename T>
+  const T* find(LveGameObject gameObject) const {
+    return isAlive(gameObject) ? pool<T>().find(gameObject.index) : nullptr;
+  }
+
+  template <typename T>
+  Access<T>& get(LveGameObject gameObject) {
+    assert(isAlive(gameObject) && "Cannot access components of a destroyed game object");
+    return pool<T>().get(gameObject.index);
+  }
+  template <typename T>
+  const T& get(LveGameObject gameObject) const {
+    assert(isAlive(gameObject) && "Cannot access components of a destroyed game object");
+    return pool<T>().get(gameObject.index);
+  }
+
+  // every game object has exactly one transform, it can't be added or removed
+  template <typename T, typename... Args>
+  T& emplace(LveGameObject gameObject, Args&&... args) {
+    static_assert(!std::is_same_v<T, TransformComponent>, "Game objects always have a transform");
+    assert(isAlive(gameObject) && "Cannot add components to a destroyed game object");
+    return pool<T>().emplace(gameObject.index, std::forward<Args>(args)...);
+  }
+
+  // stale handles are ignored
+  template <typename T>
+  void remove(LveGameObject gameObject) {
+    static_assert(!std::is_same_v<T, TransformComponent>, "Game objects always have a transform");
+    if (isAlive(gameObject)) {
+      pool<T>().remove(gameObject.index);
+    }
+  }
+
+  // marks the transform dirty and returns it for changing
+  TransformComponent& editTransform(LveGameObject gameObject);
+  // for systems iterating a pool, by the ids it lists
+  TransformComponent& editTransform(uint32_t id);
+  // recomputes the matrices of dirty transforms and the world matrices of everything below them
+  void updateTransforms();
+
+  LveGameObject makePointLight(float intensity = 10.f, float radius = 0.1f,
+                               glm::vec3 color = glm::vec3(1.f));
+
+  [[nodiscard]] size_t getGameObjectCount() const { return transformPool.size(); }
+
+  // read only, see editTransform
+  [[nodiscard]] const LveComponentPool<TransformComponent>& transforms() const {
+    return transformPool;
+  }
+  LveComponentPool<ModelComponent> models{};
+  LveComponentPool<PointLightComponent> pointLights{};
+
+private:
+  template <typename T>
+  LveComponentPool<T>& pool() {
+    return const_cast<LveComponentPool<T>&>(static_cast<const LveScene*>(this)->pool<T>());
+  }
+  template <typename T>
+  const LveComponentPool<T>& pool() const {
+    if constexpr (std::is_same_v<T, TransformComponent>) {
+      return transformPool;
+    } else if constexpr (std::is_same_v<T, ModelComponent>) {
+      return models;
+    } else {
+      static_assert(std::is_same_v<T, PointLightComponent>, "Unknown component type");
+      return pointLights;
+    }
+  }
+
+  LveGameObject allocateSlot();
+  void markTransformDirty(uint32_t index);
+  void detach(uint32_t index);
+  void updateDepths(uint32_t index);
+  void queueWorldUpdates(uint32_t index);
+
+  LveComponentPool<TransformComponent> transformPool{};
+
+  mutable std::mutex mutex{};
+  // current generation of every slot
+  std::vector<uint32_t> generations{};
+  std::vector<uint32_t> freeSlots{};
+  std::vector<LveGameObject> reserved{};
+  std::vector<LveGameObject> destroyed{};
+
+  std::vector<uint32_t> dirtyTransforms{};
+  // world matrices to recompute, by depth in the hierarchy
+  std::vector<std::vector<uint32_t>> worldUpdates{};
+  // scratch space for walking subtrees
+  std::vector<uint32_t> subtree{};
+  // the dirty transforms with Euler angles first, followed by those with quaternions
+  std::vector<uint32_t> batchedTransforms{};
+  // translation, rotation, scale and orientation of the batched transforms by component, and
+  // their matrices
+  std::vector<float> transformArrays[13]{};
+  std::vector<glm::mat4> localMatrices{};
+  std::vector<glm::mat4> localNormalMatrices{};
+};
+
+} // namespace lve
@@ -0,0 +1,47 @@
+#include "lve_thread_pool.h"
+
+// std
+#include <algorithm>
+
+namespace lve {
+
+LveThreadPool::LveThreadPool(uint32_t threadCount) {
+  for (uint32_t i = 0; i < std::max(threadCount, 1u); i++) {
+    workers.emplace_back([this]() { workerLoop(); });
+  }
+}
+
+LveThreadPool::~LveThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+uint32_t LveThreadPool::defaultThreadCount() {
+  uint32_t cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+void LveThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock{mutex};
+      jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+      // queued jobs are still run on shutdown, their futures would never be satisfied otherwise
+      if (jobs.empty()) {
+        return;
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+} // namespace lve
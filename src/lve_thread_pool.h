@@ -0,0 +1,59 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Fixed set of worker threads running jobs in submission order.
+ *
+ * Jobs must not touch the Vulkan device or any other state owned by the main thread, they are
+ * meant for CPU work like parsing assets. Creating pipelines is the one exception, see
+ * LvePipelineReloader. Results are handed back through futures.
+ */
+class LveThreadPool {
+public:
+  explicit LveThreadPool(uint32_t threadCount = defaultThreadCount());
+  ~LveThreadPool();
+
+  LveThreadPool(const LveThreadPool&) = delete;
+  LveThreadPool& operator=(const LveThreadPool&) = delete;
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& job) {
+    using Result = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      jobs.emplace_back([task]() { (*task)(); });
+    }
+    jobAvailable.notify_one();
+    return future;
+  }
+
+  [[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+  // leaves one core to the main thread
+  static uint32_t defaultThreadCount();
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers{};
+  std::deque<std::function<void()>> jobs{};
+  std::mutex mutex;
+  std::condition_variable jobAvailable;
+  bool stopping = false;
+};
+
+} // namespace lve
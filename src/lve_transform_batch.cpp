@@ -0,0 +1,194 @@
+#include "lve_transform_batch.h"
+#include <glm/gtc/quaternion.hpp>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LVE_TRANSFORM_BATCH_X86
+#include "lve_transform_batch_kernel.h"
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace lve {
+
+namespace {
+#ifdef LVE_TRANSFORM_BATCH_X86
+// SSE2 is part of x86-64, this path needs no runtime check
+struct Sse2 {
+  using F = __m128;
+  using I = __m128i;
+  static constexpr size_t WIDTH = 4;
+
+  static F load(const float* p) { return _mm_loadu_ps(p); }
+  static F set1(float v) { return _mm_set1_ps(v); }
+  static F add(F a, F b) { return _mm_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static F div(F a, F b) { return _mm_div_ps(a, b); }
+  static F andBits(F a, F b) { return _mm_and_ps(a, b); }
+  // ~a & b
+  static F andNot(F a, F b) { return _mm_andnot_ps(a, b); }
+  static F orBits(F a, F b) { return _mm_or_ps(a, b); }
+  static F xorBits(F a, F b) { return _mm_xor_ps(a, b); }
+
+  static I set1i(int32_t v) { return _mm_set1_epi32(v); }
+  static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+  static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+  static I andi(I a, I b) { return _mm_and_si128(a, b); }
+  static I andNoti(I a, I b) { return _mm_andnot_si128(a, b); }
+  static I cmpeqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+  static I toInt(F a) { return _mm_cvttps_epi32(a); }
+  static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+  static F castToFloat(I a) { return _mm_castsi128_ps(a); }
+  // moves bit 2 into the sign bit
+  static F toSignBit(I a) { return _mm_castsi128_ps(_mm_slli_epi32(a, 29)); }
+
+  // columns holds element [column * 4 + row] of all lanes, lane i is stored to dst[i]
+  static void storeMat4(glm::mat4* dst, const F (&columns)[16]) {
+    for (int column = 0; column < 4; column++) {
+      F r0 = columns[column * 4];
+      F r1 = columns[column * 4 + 1];
+      F r2 = columns[column * 4 + 2];
+      F r3 = columns[column * 4 + 3];
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      _mm_storeu_ps(&dst[0][column][0], r0);
+      _mm_storeu_ps(&dst[1][column][0], r1);
+      _mm_storeu_ps(&dst[2][column][0], r2);
+      _mm_storeu_ps(&dst[3][column][0], r3);
+    }
+  }
+};
+#endif
+
+LveTransformBatch::Isa detectIsa() {
+#ifdef LVE_TRANSFORM_BATCH_X86
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return LveTransformBatch::Isa::Sse2;
+  }
+  // the OS has to save the AVX registers as well
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return LveTransformBatch::Isa::Sse2;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0 ? LveTransformBatch::Isa::Avx2 : LveTransformBatch::Isa::Sse2;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? LveTransformBatch::Isa::Avx2
+                                        : LveTransformBatch::Isa::Sse2;
+#endif
+#else
+  return LveTransformBatch::Isa::Scalar;
+#endif
+}
+
+std::atomic<LveTransformBatch::Isa>& selectedIsa() {
+  static std::atomic<LveTransformBatch::Isa> isa{LveTransformBatch::getSupportedIsa()};
+  return isa;
+}
+} // namespace
+
+LveTransformBatch::Isa LveTransformBatch::getSupportedIsa() {
+  static const Isa supported = detectIsa();
+  return supported;
+}
+
+LveTransformBatch::Isa LveTransformBatch::getIsa() { return selectedIsa().load(); }
+
+void LveTransformBatch::setIsa(Isa isa) {
+  selectedIsa().store(std::min(isa, getSupportedIsa()));
+}
+
+const char* LveTransformBatch::isaName(Isa isa) {
+  switch (isa) {
+  case Isa::Sse2:
+    return "SSE2";
+  case Isa::Avx2:
+    return "AVX2";
+  default:
+    return "scalar";
+  }
+}
+
+void LveTransformBatch::compose(const Input& input, size_t count, glm::mat4* models,
+                                glm::mat4* normals) {
+  dispatch(input, count, models, normals, false);
+}
+
+void LveTransformBatch::composeQuaternions(const Input& input, size_t count, glm::mat4* models,
+                                           glm::mat4* normals) {
+  dispatch(input, count, models, normals, true);
+}
+
+void LveTransformBatch::dispatch(const Input& input, size_t count, glm::mat4* models,
+                                 glm::mat4* normals, bool quaternions) {
+  // the vector paths leave the remainder that doesn't fill a whole vector to the scalar one
+  size_t vectorized = 0;
+#ifdef LVE_TRANSFORM_BATCH_X86
+  switch (getIsa()) {
+  case Isa::Avx2:
+    vectorized = count - count % 8;
+    composeAvx2(input, 0, vectorized, models, normals, quaternions);
+    break;
+  case Isa::Sse2:
+    vectorized = count - count % 4;
+    composeSse2(input, 0, vectorized, models, normals, quaternions);
+    break;
+  default:
+    break;
+  }
+#endif
+  composeScalar(input, vectorized, count - vectorized, models, normals, quaternions);
+}
+
+void LveTransformBatch::composeScalar(const Input& input, size_t first, size_t count,
+                                      glm::mat4* models, glm::mat4* normals, bool quaternions) {
+  for (size_t i = first; i < first + count; i++) {
+    glm::mat3 rotation{};
+    if (quaternions) {
+      rotation = glm::mat3_cast(glm::quat{input.orientation[3][i], input.orientation[0][i],
+                                          input.orientation[1][i], input.orientation[2][i]});
+    } else {
+      const float c3 = std::cos(input.rotation[2][i]);
+      const float s3 = std::sin(input.rotation[2][i]);
+      const float c2 = std::cos(input.rotation[0][i]);
+      const float s2 = std::sin(input.rotation[0][i]);
+      const float c1 = std::cos(input.rotation[1][i]);
+      const float s1 = std::sin(input.rotation[1][i]);
+      rotation = glm::mat3{{c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1},
+                           {c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3},
+                           {c2 * s1, -s2, c1 * c2}};
+    }
+    const glm::vec3 scale{input.scale[0][i], input.scale[1][i], input.scale[2][i]};
+
+    models[i] = glm::mat4{glm::vec4(rotation[0] * scale.x, 0.f),
+                          glm::vec4(rotation[1] * scale.y, 0.f),
+                          glm::vec4(rotation[2] * scale.z, 0.f),
+                          {input.translation[0][i], input.translation[1][i],
+                           input.translation[2][i], 1.f}};
+    if (normals != nullptr) {
+      normals[i] = glm::mat4{glm::mat3{rotation[0] / scale.x, rotation[1] / scale.y,
+                                       rotation[2] / scale.z}};
+    }
+  }
+}
+
+#ifdef LVE_TRANSFORM_BATCH_X86
+void LveTransformBatch::composeSse2(const Input& input, size_t first, size_t count,
+                                    glm::mat4* models, glm::mat4* normals, bool quaternions) {
+  composeTransforms<Sse2>(input, first, count, models, normals, quaternions);
+}
+#endif
+
+} // namespace lve
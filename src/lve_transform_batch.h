@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+
+namespace lve {
+
+/*
+ * Computes the model matrices of many transforms at once.
+ *
+ * Transforms are passed as a structure of arrays and are composed like TransformComponent::mat4,
+ * several per iteration with SSE2 or AVX2. compose takes Euler angles, composeQuaternions unit
+ * quaternions, which need no trigonometry at all. The instruction set is picked at runtime from
+ * what the CPU supports, everything else uses the scalar path. The vector paths evaluate sine and
+ * cosine with polynomials, which deviate from the scalar path by a few ulp.
+ */
+class LveTransformBatch {
+public:
+  enum class Isa { Scalar, Sse2, Avx2 };
+
+  // count transforms, every array holds one component of each of them
+  struct Input {
+    const float* translation[3];
+    // Tait-Bryan angles, see TransformComponent. Only read by compose
+    const float* rotation[3];
+    // has to be non zero where normal matrices are computed
+    const float* scale[3];
+    // x, y, z and w of unit quaternions. Only read by composeQuaternions
+    const float* orientation[4];
+  };
+
+  /**
+   * Writes the model matrix of every transform to models and, unless normals is nullptr, the
+   * inverse transpose of its upper 3x3 to normals, padded to a mat4 as shaders expect it
+   */
+  static void compose(const Input& input, size_t count, glm::mat4* models,
+                      glm::mat4* normals = nullptr);
+  static void composeQuaternions(const Input& input, size_t count, glm::mat4* models,
+                                 glm::mat4* normals = nullptr);
+
+  // the instruction set compose uses
+  static Isa getIsa();
+  // overrides the detected instruction set, for comparing the paths. Falls back to the next
+  // narrower one the CPU supports
+  static void setIsa(Isa isa);
+  static Isa getSupportedIsa();
+
+  static const char* isaName(Isa isa);
+
+private:
+  static void dispatch(const Input& input, size_t count, glm::mat4* models, glm::mat4* normals,
+                       bool quaternions);
+
+  static void composeScalar(const Input& input, size_t first, size_t count, glm::mat4* models,
+                            glm::mat4* normals, bool quaternions);
+  // compose count transforms starting at first, count has to be a multiple of the vector width
+  static void composeSse2(const Input& input, size_t first, size_t count, glm::mat4* models,
+                          glm::mat4* normals, bool quaternions);
+  static void composeAvx2(const Input& input, size_t first, size_t count, glm::mat4* models,
+                          glm::mat4* normals, bool quaternions);
+};
+
+} // namespace lve
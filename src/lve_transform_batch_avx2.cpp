@@ -0,0 +1,95 @@
+// Only the functions defined below the target pragma are compiled for AVX2, nothing in here may
+// run before LveTransformBatch checked the CPU. glm and the standard library are included before
+// it: their inline functions are emitted as weak symbols the linker may pick from any object, so
+// they have to keep the baseline instruction set. The kernel stores through raw float pointers and
+// calls no glm code.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include "lve_transform_batch.h"
+#include <immintrin.h>
+
+// std
+#include <cstdint>
+
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "storeMat4 writes matrices as raw floats");
+
+// MSVC compiles AVX2 intrinsics without any option
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "lve_transform_batch_kernel.h"
+
+namespace lve {
+
+namespace {
+struct Avx2 {
+  using F = __m256;
+  using I = __m256i;
+  static constexpr size_t WIDTH = 8;
+
+  static F load(const float* p) { return _mm256_loadu_ps(p); }
+  static F set1(float v) { return _mm256_set1_ps(v); }
+  static F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static F div(F a, F b) { return _mm256_div_ps(a, b); }
+  static F andBits(F a, F b) { return _mm256_and_ps(a, b); }
+  // ~a & b
+  static F andNot(F a, F b) { return _mm256_andnot_ps(a, b); }
+  static F orBits(F a, F b) { return _mm256_or_ps(a, b); }
+  static F xorBits(F a, F b) { return _mm256_xor_ps(a, b); }
+
+  static I set1i(int32_t v) { return _mm256_set1_epi32(v); }
+  static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+  static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+  static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+  static I andNoti(I a, I b) { return _mm256_andnot_si256(a, b); }
+  static I cmpeqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+  static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+  static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+  static F castToFloat(I a) { return _mm256_castsi256_ps(a); }
+  // moves bit 2 into the sign bit
+  static F toSignBit(I a) { return _mm256_castsi256_ps(_mm256_slli_epi32(a, 29)); }
+
+  // columns holds element [column * 4 + row] of all lanes, lane i is stored to dst[i]
+  static void storeMat4(glm::mat4* dst, const F (&columns)[16]) {
+    for (int column = 0; column < 4; column++) {
+      // 4x4 transposes within both 128 bit halves, the upper half holds lanes 4 to 7
+      F t0 = _mm256_unpacklo_ps(columns[column * 4], columns[column * 4 + 1]);
+      F t1 = _mm256_unpackhi_ps(columns[column * 4], columns[column * 4 + 1]);
+      F t2 = _mm256_unpacklo_ps(columns[column * 4 + 2], columns[column * 4 + 3]);
+      F t3 = _mm256_unpackhi_ps(columns[column * 4 + 2], columns[column * 4 + 3]);
+      F lanes[4] = {
+          _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+          _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+          _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+          _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+      };
+      for (int lane = 0; lane < 4; lane++) {
+        float* low = reinterpret_cast<float*>(dst + lane) + column * 4;
+        float* high = reinterpret_cast<float*>(dst + lane + 4) + column * 4;
+        _mm_storeu_ps(low, _mm256_castps256_ps128(lanes[lane]));
+        _mm_storeu_ps(high, _mm256_extractf128_ps(lanes[lane], 1));
+      }
+    }
+  }
+};
+} // namespace
+
+void LveTransformBatch::composeAvx2(const Input& input, size_t first, size_t count,
+                                    glm::mat4* models, glm::mat4* normals, bool quaternions) {
+  composeTransforms<Avx2>(input, first, count, models, normals, quaternions);
+}
+
+} // namespace lve
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
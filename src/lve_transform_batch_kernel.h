@@ -0,0 +1,187 @@
+#pragma once
+
+// Vector body of LveTransformBatch, included by the translation unit of every instruction set with
+// a wrapper V around its intrinsics. Everything has internal linkage, so the instantiations
+// compiled for different instruction sets never get merged by the linker.
+
+#include "lve_transform_batch.h"
+
+// std
+#include <cstdint>
+
+namespace lve {
+namespace {
+
+/**
+ * Sine and cosine of every lane, accurate to a few ulp for |x| < 8192. Cephes' single precision
+ * approximation: x is reduced to [-pi/4, pi/4] by its octant, which selects the polynomial and
+ * the sign of each result
+ */
+template <typename V>
+inline void sinCos(typename V::F x, typename V::F& sinOut, typename V::F& cosOut) {
+  using F = typename V::F;
+  using I = typename V::I;
+
+  const F signMask = V::castToFloat(V::set1i(INT32_MIN));
+  F sinSign = V::andBits(x, signMask);
+  x = V::andNot(signMask, x);
+
+  // octant rounded up to an even number, so the remainder is centered around 0
+  I octant = V::toInt(V::mul(x, V::set1(1.27323954473516f)));
+  octant = V::andi(V::addi(octant, V::set1i(1)), V::set1i(~1));
+  F y = V::toFloat(octant);
+
+  sinSign = V::xorBits(sinSign, V::toSignBit(V::andi(octant, V::set1i(4))));
+  F cosSign = V::toSignBit(V::andNoti(V::subi(octant, V::set1i(2)), V::set1i(4)));
+  // octants 2, 3, 6 and 7 swap the polynomials
+  F polynomialMask = V::castToFloat(V::cmpeqi(V::andi(octant, V::set1i(2)), V::set1i(0)));
+
+  // pi / 4 split into three parts for extended precision
+  x = V::sub(x, V::mul(y, V::set1(0.78515625f)));
+  x = V::sub(x, V::mul(y, V::set1(2.4187564849853515625e-4f)));
+  x = V::sub(x, V::mul(y, V::set1(3.77489497744594108e-8f)));
+  F z = V::mul(x, x);
+
+  F cosPolynomial = V::set1(2.443315711809948e-5f);
+  cosPolynomial = V::add(V::mul(cosPolynomial, z), V::set1(-1.388731625493765e-3f));
+  cosPolynomial = V::add(V::mul(cosPolynomial, z), V::set1(4.166664568298827e-2f));
+  cosPolynomial = V::mul(V::mul(cosPolynomial, z), z);
+  cosPolynomial = V::sub(cosPolynomial, V::mul(z, V::set1(0.5f)));
+  cosPolynomial = V::add(cosPolynomial, V::set1(1.f));
+
+  F sinPolynomial = V::set1(-1.9515295891e-4f);
+  sinPolynomial = V::add(V::mul(sinPolynomial, z), V::set1(8.3321608736e-3f));
+  sinPolynomial = V::add(V::mul(sinPolynomial, z), V::set1(-1.6666654611e-1f));
+  sinPolynomial = V::add(V::mul(V::mul(sinPolynomial, z), x), x);
+
+  F sin = V::orBits(V::andBits(polynomialMask, sinPolynomial),
+                    V::andNot(polynomialMask, cosPolynomial));
+  F cos = V::orBits(V::andBits(polynomialMask, cosPolynomial),
+                    V::andNot(polynomialMask, sinPolynomial));
+  sinOut = V::xorBits(sin, sinSign);
+  cosOut = V::xorBits(cos, cosSign);
+}
+
+// rotation matrix of TransformComponent::mat4 by column
+template <typename V>
+inline void eulerRotation(const LveTransformBatch::Input& input, size_t i,
+                          typename V::F (&rotation)[9]) {
+  using F = typename V::F;
+
+  F s1, c1, s2, c2, s3, c3;
+  sinCos<V>(V::load(input.rotation[1] + i), s1, c1);
+  sinCos<V>(V::load(input.rotation[0] + i), s2, c2);
+  sinCos<V>(V::load(input.rotation[2] + i), s3, c3);
+
+  F c1s2 = V::mul(c1, s2);
+  F s1s2 = V::mul(s1, s2);
+  rotation[0] = V::add(V::mul(c1, c3), V::mul(s1s2, s3));
+  rotation[1] = V::mul(c2, s3);
+  rotation[2] = V::sub(V::mul(c1s2, s3), V::mul(c3, s1));
+  rotation[3] = V::sub(V::mul(c3, s1s2), V::mul(c1, s3));
+  rotation[4] = V::mul(c2, c3);
+  rotation[5] = V::add(V::mul(c1s2, c3), V::mul(s1, s3));
+  rotation[6] = V::mul(c2, s1);
+  rotation[7] = V::sub(V::set1(0.f), s2);
+  rotation[8] = V::mul(c1, c2);
+}
+
+// rotation matrix of a unit quaternion by column, like glm::mat3_cast
+template <typename V>
+inline void quaternionRotation(const LveTransformBatch::Input& input, size_t i,
+                               typename V::F (&rotation)[9]) {
+  using F = typename V::F;
+
+  F x = V::load(input.orientation[0] + i);
+  F y = V::load(input.orientation[1] + i);
+  F z = V::load(input.orientation[2] + i);
+  F w = V::load(input.orientation[3] + i);
+
+  const F one = V::set1(1.f);
+  const F two = V::set1(2.f);
+  F xx = V::mul(x, x);
+  F yy = V::mul(y, y);
+  F zz = V::mul(z, z);
+  F xy = V::mul(x, y);
+  F xz = V::mul(x, z);
+  F yz = V::mul(y, z);
+  F wx = V::mul(w, x);
+  F wy = V::mul(w, y);
+  F wz = V::mul(w, z);
+
+  rotation[0] = V::sub(one, V::mul(two, V::add(yy, zz)));
+  rotation[1] = V::mul(two, V::add(xy, wz));
+  rotation[2] = V::mul(two, V::sub(xz, wy));
+  rotation[3] = V::mul(two, V::sub(xy, wz));
+  rotation[4] = V::sub(one, V::mul(two, V::add(xx, zz)));
+  rotation[5] = V::mul(two, V::add(yz, wx));
+  rotation[6] = V::mul(two, V::add(xz, wy));
+  rotation[7] = V::mul(two, V::sub(yz, wx));
+  rotation[8] = V::sub(one, V::mul(two, V::add(xx, yy)));
+}
+
+// count has to be a multiple of V::WIDTH
+template <typename V, bool QUATERNIONS>
+inline void composeTransforms(const LveTransformBatch::Input& input, size_t first, size_t count,
+                              glm::mat4* models, glm::mat4* normals) {
+  using F = typename V::F;
+
+  const F zero = V::set1(0.f);
+  const F one = V::set1(1.f);
+  for (size_t i = first; i < first + count; i += V::WIDTH) {
+    F rotation[9];
+    if (QUATERNIONS) {
+      quaternionRotation<V>(input, i, rotation);
+    } else {
+      eulerRotation<V>(input, i, rotation);
+    }
+
+    F scale[3] = {V::load(input.scale[0] + i), V::load(input.scale[1] + i),
+                  V::load(input.scale[2] + i)};
+    F model[16]{};
+    for (int column = 0; column < 3; column++) {
+      for (int row = 0; row < 3; row++) {
+        model[column * 4 + row] = V::mul(scale[column], rotation[column * 3 + row]);
+      }
+      model[column * 4 + 3] = zero;
+    }
+    model[12] = V::load(input.translation[0] + i);
+    model[13] = V::load(input.translation[1] + i);
+    model[14] = V::load(input.translation[2] + i);
+    model[15] = one;
+    V::storeMat4(models + i, model);
+
+    if (normals == nullptr) {
+      continue;
+    }
+
+    // the rotation is orthonormal, so the inverse transpose of rotation * scale is
+    // rotation * scale^-1
+    F normal[16]{};
+    for (int column = 0; column < 3; column++) {
+      F inverseScale = V::div(one, scale[column]);
+      for (int row = 0; row < 3; row++) {
+        normal[column * 4 + row] = V::mul(inverseScale, rotation[column * 3 + row]);
+      }
+      normal[column * 4 + 3] = zero;
+    }
+    normal[12] = zero;
+    normal[13] = zero;
+    normal[14] = zero;
+    normal[15] = one;
+    V::storeMat4(normals + i, normal);
+  }
+}
+
+template <typename V>
+inline void composeTransforms(const LveTransformBatch::Input& input, size_t first, size_t count,
+                              glm::mat4* models, glm::mat4* normals, bool quaternions) {
+  if (quaternions) {
+    composeTransforms<V, true>(input, first, count, models, normals);
+  } else {
+    composeTransforms<V, false>(input, first, count, models, normals);
+  }
+}
+
+} // namespace
+} // namespace lve
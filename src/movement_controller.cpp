@@ -5,9 +5,9 @@
 namespace lve {
 
 void MovementController::moveInPlaneXZ(GLFWwindow* window, float dt,
-                                       LveGameObject& gameObject) const {
+                                       TransformComponent& transform) const {
 
-  float yaw = gameObject.transform.rotation.y;
+  float yaw = transform.rotation.y;
   const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
   const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
   const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -34,11 +34,11 @@ void MovementController::moveInPlaneXZ(GLFWwindow* window, float dt,
   }
 
   if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
-    gameObject.transform.translation += moveSpeed * dt * glm::normalize(moveDir);
+    transform.translation += moveSpeed * dt * glm::normalize(moveDir);
   }
 }
 void MovementController::handleMouseMovement(GLFWwindow* window, float dt,
-                                             LveGameObject& gameObject) {
+                                             TransformComponent& transform) {
   glm::vec3 rotate{};
 
   double x{}, y{};
@@ -51,8 +51,8 @@ void MovementController::handleMouseMovement(GLFWwindow* window, float dt,
   lastX = static_cast<float>(x);
   lastY = static_cast<float>(y);
 
-  gameObject.transform.rotation.y += glm::mod(dt * xDiff * lookSpeed, glm::two_pi<float>());
-  gameObject.transform.rotation.x -= glm::clamp(dt * yDiff * lookSpeed, -1.5f, 1.5f);
+  transform.rotation.y += glm::mod(dt * xDiff * lookSpeed, glm::two_pi<float>());
+  transform.rotation.x -= glm::clamp(dt * yDiff * lookSpeed, -1.5f, 1.5f);
 
   int width, height;
   glfwGetWindowSize(window, &width, &height);
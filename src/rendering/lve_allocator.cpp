@@ -0,0 +1,364 @@
+#include "lve_allocator.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <fmt/core.h>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment) {
+  return value / alignment * alignment;
+}
+
+LveAllocator::LveAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+                           VkDeviceSize preferredBlockSize)
+    : device{device}, preferredBlockSize{preferredBlockSize} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+LveAllocator::~LveAllocator() {
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (blocks[i] != nullptr) {
+      assert(blocks[i]->allocationCount == 0 && "Destroying allocator with live allocations");
+      releaseBlock(i);
+    }
+  }
+}
+
+/**
+ * Sub-allocates memory for a resource from a block of the given memory type, creating a new block
+ * when none of the existing ones has a large enough free range
+ *
+ * @param requirements Memory requirements as returned by vkGet*MemoryRequirements
+ * @param memoryTypeIndex Memory type to allocate from (see LveDevice::findMemoryType)
+ * @param kind Whether the memory backs a buffer or an optimal tiling image
+ *
+ * @return The allocation, to be passed back to free() once the resource is destroyed
+ */
+LveAllocation LveAllocator::allocate(const VkMemoryRequirements& requirements,
+                                     uint32_t memoryTypeIndex, ResourceKind kind) {
+  VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+  VkDeviceSize size = requirements.size;
+
+  // keeps flushes of one allocation from touching the atoms of its neighbours
+  if (isHostVisible(memoryTypeIndex) && !isHostCoherent(memoryTypeIndex)) {
+    alignment = std::max(alignment, nonCoherentAtomSize);
+    size = alignUp(size, nonCoherentAtomSize);
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  uint32_t blockIndex = std::numeric_limits<uint32_t>::max();
+  VkDeviceSize offset = 0;
+
+  const VkDeviceSize blockSize = blockSizeFor(memoryTypeIndex);
+  if (size > blockSize / 2) {
+    // large resources get a block of their own instead of wasting the tail of a shared one
+    blockIndex = createBlock(memoryTypeIndex, size, kind, true);
+    allocateFromBlock(*blocks[blockIndex], size, alignment, offset);
+  } else {
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+      auto& block = blocks[i];
+      if (block == nullptr || block->dedicated || block->memoryTypeIndex != memoryTypeIndex ||
+          block->kind != kind) {
+        continue;
+      }
+      if (allocateFromBlock(*block, size, alignment, offset)) {
+        blockIndex = i;
+        break;
+      }
+    }
+
+    if (blockIndex == std::numeric_limits<uint32_t>::max()) {
+      blockIndex = createBlock(memoryTypeIndex, blockSize, kind, false);
+      allocateFromBlock(*blocks[blockIndex], size, alignment, offset);
+    }
+  }
+
+  auto& block = *blocks[blockIndex];
+  block.used += size;
+  block.allocationCount++;
+
+  auto& heap = heapUsageOf(memoryTypeIndex);
+  heap.usedBytes += size;
+  heap.peakUsedBytes = std::max(heap.peakUsedBytes, heap.usedBytes);
+  heap.allocationCount++;
+
+  LveAllocation allocation{};
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.blockIndex = blockIndex;
+  if (block.mapped != nullptr) {
+    allocation.mapped = static_cast<char*>(block.mapped) + offset;
+  }
+  return allocation;
+}
+
+/**
+ * Returns an allocation to its block. Empty blocks are released, except for one spare block per
+ * memory type which is kept around to avoid allocation churn
+ *
+ * @param allocation Allocation to free, reset to an invalid allocation afterwards
+ */
+void LveAllocator::free(LveAllocation& allocation) {
+  if (!allocation.isValid()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  assert(allocation.blockIndex < blocks.size() && blocks[allocation.blockIndex] != nullptr &&
+         "Freeing allocation of unknown block");
+  auto& block = *blocks[allocation.blockIndex];
+
+  auto& heap = heapUsageOf(block.memoryTypeIndex);
+  heap.usedBytes -= allocation.size;
+  heap.allocationCount--;
+
+  auto next = block.freeRanges.lower_bound(allocation.offset);
+  VkDeviceSize offset = allocation.offset;
+  VkDeviceSize size = allocation.size;
+
+  if (next != block.freeRanges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      block.freeRanges.erase(prev);
+    }
+  }
+  if (next != block.freeRanges.end() && offset + size == next->first) {
+    size += next->second;
+    block.freeRanges.erase(next);
+  }
+  block.freeRanges[offset] = size;
+
+  block.used -= allocation.size;
+  block.allocationCount--;
+
+  if (block.allocationCount == 0) {
+    bool hasSpare = false;
+    for (uint32_t i = 0; i < blocks.size(); i++) {
+      const auto& other = blocks[i];
+      if (i != allocation.blockIndex && other != nullptr && !other->dedicated &&
+          other->allocationCount == 0 && other->memoryTypeIndex == block.memoryTypeIndex &&
+          other->kind == block.kind) {
+        hasSpare = true;
+        break;
+      }
+    }
+    if (block.dedicated || hasSpare) {
+      releaseBlock(allocation.blockIndex);
+    }
+  }
+
+  allocation = LveAllocation{};
+}
+
+VkMappedMemoryRange LveAllocator::mappedRange(const LveAllocation& allocation, VkDeviceSize size,
+                                              VkDeviceSize offset) const {
+  assert(offset <= allocation.size && "Mapped range starts past the end of the allocation");
+
+  VkDeviceSize begin = allocation.offset + offset;
+  VkDeviceSize end = allocation.offset + allocation.size;
+  if (size != VK_WHOLE_SIZE) {
+    end = std::min(end, begin + size);
+  }
+
+  if (!isHostCoherent(allocation.memoryTypeIndex)) {
+    // allocations of non-coherent types start and end on atom boundaries, see allocate()
+    begin = alignDown(begin, nonCoherentAtomSize);
+    end = std::min(alignUp(end, nonCoherentAtomSize), allocation.offset + allocation.size);
+  }
+
+  VkMappedMemoryRange range{};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = allocation.memory;
+  range.offset = begin;
+  range.size = end - begin;
+  return range;
+}
+
+LveAllocatorStats LveAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  LveAllocatorStats stats{};
+  for (const auto& block : blocks) {
+    if (block != nullptr) {
+      addToStats(*block, stats);
+    }
+  }
+  return stats;
+}
+
+LveAllocatorStats LveAllocator::getStats(uint32_t memoryTypeIndex) const {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  LveAllocatorStats stats{};
+  for (const auto& block : blocks) {
+    if (block != nullptr && block->memoryTypeIndex == memoryTypeIndex) {
+      addToStats(*block, stats);
+    }
+  }
+  return stats;
+}
+
+LveHeapUsage LveAllocator::getHeapUsage(uint32_t heapIndex) const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return heapUsage[heapIndex];
+}
+
+void LveAllocator::printStats() const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    auto stats = getStats(i);
+    if (stats.blockCount == 0) {
+      continue;
+    }
+    fmt::println("memory type {}: {} allocations in {} blocks, {} / {} KiB used, "
+                 "{} free ranges, fragmentation {:.2f}",
+                 i, stats.allocationCount, stats.blockCount, stats.usedBytes / 1024,
+                 stats.blockBytes / 1024, stats.freeRangeCount, stats.fragmentation());
+  }
+}
+
+bool LveAllocator::allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment,
+                                     VkDeviceSize& offset) {
+  if (block.size - block.used < size) {
+    return false;
+  }
+
+  // best fit: pick the free range that leaves the smallest remainder
+  auto best = block.freeRanges.end();
+  VkDeviceSize bestRemainder = std::numeric_limits<VkDeviceSize>::max();
+  for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+    VkDeviceSize alignedOffset = alignUp(it->first, alignment);
+    VkDeviceSize rangeEnd = it->first + it->second;
+    if (alignedOffset + size > rangeEnd) {
+      continue;
+    }
+    VkDeviceSize remainder = rangeEnd - (alignedOffset + size);
+    if (remainder < bestRemainder) {
+      best = it;
+      bestRemainder = remainder;
+      if (remainder == 0) {
+        break;
+      }
+    }
+  }
+
+  if (best == block.freeRanges.end()) {
+    return false;
+  }
+
+  VkDeviceSize rangeOffset = best->first;
+  VkDeviceSize rangeEnd = best->first + best->second;
+  offset = alignUp(rangeOffset, alignment);
+  block.freeRanges.erase(best);
+
+  if (offset > rangeOffset) {
+    block.freeRanges[rangeOffset] = offset - rangeOffset;
+  }
+  if (offset + size < rangeEnd) {
+    block.freeRanges[offset + size] = rangeEnd - (offset + size);
+  }
+  return true;
+}
+
+uint32_t LveAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, ResourceKind kind,
+                                   bool dedicated) {
+  auto block = std::make_unique<Block>();
+  block->size = size;
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->kind = kind;
+  block->dedicated = dedicated;
+  block->freeRanges[0] = size;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate memory block!");
+  }
+
+  if (isHostVisible(memoryTypeIndex)) {
+    if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, block->memory, nullptr);
+      throw std::runtime_error("failed to map memory block!");
+    }
+  }
+
+  auto& heap = heapUsageOf(memoryTypeIndex);
+  heap.blockBytes += size;
+  heap.peakBlockBytes = std::max(heap.peakBlockBytes, heap.blockBytes);
+
+  for (uint32_t i = 0; i < blocks.size(); i++) {
+    if (blocks[i] == nullptr) {
+      blocks[i] = std::move(block);
+      return i;
+    }
+  }
+  blocks.push_back(std::move(block));
+  return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void LveAllocator::releaseBlock(uint32_t blockIndex) {
+  auto& block = blocks[blockIndex];
+  if (block->mapped != nullptr) {
+    vkUnmapMemory(device, block->memory);
+  }
+  vkFreeMemory(device, block->memory, nullptr);
+  heapUsageOf(block->memoryTypeIndex).blockBytes -= block->size;
+  block.reset();
+}
+
+LveHeapUsage& LveAllocator::heapUsageOf(uint32_t memoryTypeIndex) {
+  return heapUsage[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+}
+
+void LveAllocator::addToStats(const Block& block, LveAllocatorStats& stats) const {
+  stats.blockBytes += block.size;
+  stats.usedBytes += block.used;
+  stats.blockCount++;
+  stats.allocationCount += block.allocationCount;
+  stats.freeRangeCount += static_cast<uint32_t>(block.freeRanges.size());
+  for (const auto& [offset, size] : block.freeRanges) {
+    stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+  }
+}
+
+bool LveAllocator::isHostVisible(uint32_t memoryTypeIndex) const {
+  return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+bool LveAllocator::isHostCoherent(uint32_t memoryTypeIndex) const {
+  return memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+VkDeviceSize LveAllocator::blockSizeFor(uint32_t memoryTypeIndex) const {
+  // small heaps (e.g. the 256 MiB BAR heap) get smaller blocks so one block can't exhaust them
+  uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+  if (heapSize <= 1024ull * 1024 * 1024) {
+    return std::min(preferredBlockSize, heapSize / 8);
+  }
+  return preferredBlockSize;
+}
+
+} // namespace lve
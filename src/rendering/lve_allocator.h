@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+/*
+ * A sub-range of a VkDeviceMemory block handed out by LveAllocator.
+ *
+ * Host visible blocks are mapped once for their whole lifetime, so mapped points at the first
+ * byte of this allocation (or is nullptr for memory that can't be mapped).
+ */
+struct LveAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mapped = nullptr;
+  uint32_t memoryTypeIndex = 0;
+  uint32_t blockIndex = 0;
+
+  [[nodiscard]] bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct LveAllocatorStats {
+  VkDeviceSize blockBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+  uint32_t blockCount = 0;
+  uint32_t allocationCount = 0;
+  uint32_t freeRangeCount = 0;
+
+  // 0 when all free space is one contiguous range, approaching 1 the more it is split up
+  [[nodiscard]] float fragmentation() const {
+    VkDeviceSize freeBytes = blockBytes - usedBytes;
+    if (freeBytes == 0) {
+      return 0.f;
+    }
+    return 1.f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+  }
+};
+
+// Memory the allocator holds in one heap, peaks are kept since the allocator was created
+struct LveHeapUsage {
+  VkDeviceSize blockBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize peakBlockBytes = 0;
+  VkDeviceSize peakUsedBytes = 0;
+  uint32_t allocationCount = 0;
+};
+
+/*
+ * Block based sub-allocator for device memory.
+ *
+ * Keeps a list of large VkDeviceMemory blocks per memory type and places resources inside them
+ * at aligned offsets, so the number of vkAllocateMemory calls stays far below
+ * maxMemoryAllocationCount. Buffers and optimal tiling images never share a block, which keeps us
+ * clear of bufferImageGranularity issues without padding every allocation.
+ */
+class LveAllocator {
+public:
+  enum class ResourceKind { Buffer, Image };
+
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+  LveAllocator(VkDevice device, VkPhysicalDevice physicalDevice,
+               VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+  ~LveAllocator();
+
+  LveAllocator(const LveAllocator&) = delete;
+  LveAllocator& operator=(const LveAllocator&) = delete;
+
+  LveAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex,
+                         ResourceKind kind);
+  void free(LveAllocation& allocation);
+
+  // Returns a flush/invalidate range for the given part of an allocation, expanded to
+  // nonCoherentAtomSize as the spec requires for non-coherent memory
+  [[nodiscard]] VkMappedMemoryRange mappedRange(const LveAllocation& allocation,
+                                                VkDeviceSize size = VK_WHOLE_SIZE,
+                                                VkDeviceSize offset = 0) const;
+
+  [[nodiscard]] LveAllocatorStats getStats() const;
+  [[nodiscard]] LveAllocatorStats getStats(uint32_t memoryTypeIndex) const;
+  [[nodiscard]] LveHeapUsage getHeapUsage(uint32_t heapIndex) const;
+  void printStats() const;
+
+  [[nodiscard]] VkDeviceSize getNonCoherentAtomSize() const { return nonCoherentAtomSize; }
+
+  [[nodiscard]] const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const {
+    return memoryProperties;
+  }
+
+private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    void* mapped = nullptr;
+    uint32_t memoryTypeIndex = 0;
+    uint32_t allocationCount = 0;
+    ResourceKind kind = ResourceKind::Buffer;
+    bool dedicated = false;
+    // offset -> size of every free range, adjacent ranges are always merged
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges{};
+  };
+
+  bool allocateFromBlock(Block& block, VkDeviceSize size, VkDeviceSize alignment,
+                         VkDeviceSize& offset);
+  uint32_t createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, ResourceKind kind,
+                       bool dedicated);
+  void releaseBlock(uint32_t blockIndex);
+  void addToStats(const Block& block, LveAllocatorStats& stats) const;
+  LveHeapUsage& heapUsageOf(uint32_t memoryTypeIndex);
+
+  [[nodiscard]] bool isHostVisible(uint32_t memoryTypeIndex) const;
+  [[nodiscard]] bool isHostCoherent(uint32_t memoryTypeIndex) const;
+  [[nodiscard]] VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex) const;
+
+  VkDevice device;
+  VkDeviceSize preferredBlockSize;
+  VkDeviceSize nonCoherentAtomSize;
+  VkPhysicalDeviceMemoryProperties memoryProperties{};
+  LveHeapUsage heapUsage[VK_MAX_MEMORY_HEAPS]{};
+
+  // indices are handed out in LveAllocation::blockIndex, released slots are reused
+  std::vector<std::unique_ptr<Block>> blocks{};
+  mutable std::mutex mutex;
+};
+
+} // namespace lve
@@ -8,6 +8,7 @@
 #include "lve_buffer.h"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -41,41 +42,45 @@ LveBuffer::LveBuffer(LveDevice& device, VkDeviceSize instanceSize,
   alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
   bufferSize = alignmentSize * instanceCount;
   device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer,
-                      memory);
+                      allocation);
 }
 
 LveBuffer::~LveBuffer() {
   unmap();
-  vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
-  vkFreeMemory(lveDevice.device(), memory, nullptr);
+  lveDevice.destroyBuffer(buffer, allocation);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the
  * specified buffer range.
  *
+ * @note Host visible memory blocks stay mapped for their whole lifetime, so
+ * this only hands out a pointer into the block's mapping
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to
  * map the complete buffer range.
  * @param offset (Optional) Byte offset from beginning
  *
- * @return VkResult of the buffer mapping call
+ * @return VkResult of the buffer mapping call, VK_ERROR_MEMORY_MAP_FAILED if the
+ * range doesn't lie within the buffer
  */
 VkResult LveBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(lveDevice.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && allocation.isValid() && "Called map on buffer before create");
+  VkDeviceSize end = size == VK_WHOLE_SIZE ? bufferSize : offset + size;
+  if (allocation.mapped == nullptr || offset > bufferSize || end > bufferSize) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char*>(allocation.mapped) + offset;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The underlying memory block stays mapped, it is shared with other
+ * allocations
  */
-void LveBuffer::unmap() {
-  if (mapped) {
-    vkUnmapMemory(lveDevice.device(), memory);
-    mapped = nullptr;
-  }
-}
+void LveBuffer::unmap() { mapped = nullptr; }
 
 /**
  * Copies the specified data to the mapped buffer. Default value writes whole
@@ -98,6 +103,93 @@ void LveBuffer::writeToBuffer(void* data, VkDeviceSize size,
     memOffset += offset;
     memcpy(memOffset, data, size);
   }
+  markDirty(size, offset);
+}
+
+/**
+ * Enables or disables recording of written ranges for flushDirty(). Disabling
+ * drops ranges that haven't been flushed yet
+ */
+void LveBuffer::enableDirtyTracking(bool enabled) {
+  trackDirty = enabled;
+  dirtyRanges.clear();
+}
+
+/**
+ * Records a range as written, for data that was written through the mapped
+ * pointer directly. Does nothing unless dirty tracking is enabled
+ *
+ * @param size (Optional) Size of the written range. Pass VK_WHOLE_SIZE to mark
+ * the complete buffer range.
+ * @param offset (Optional) Byte offset from beginning
+ */
+void LveBuffer::markDirty(VkDeviceSize size, VkDeviceSize offset) {
+  if (!trackDirty) {
+    return;
+  }
+  if (size == VK_WHOLE_SIZE) {
+    dirtyRanges.emplace_back(0, bufferSize);
+  } else if (size > 0) {
+    dirtyRanges.emplace_back(offset, offset + size);
+  }
+}
+
+/**
+ * Flushes every range written since the last call. Ranges are expanded to
+ * nonCoherentAtomSize first and then merged, so no atom is flushed twice and
+ * the device sees the minimum number of ranges
+ *
+ * @note Coherent memory needs no flushes, the recorded ranges are just dropped
+ *
+ * @return VkResult of the flush call
+ */
+VkResult LveBuffer::flushDirty() {
+  auto& allocator = lveDevice.allocator();
+  VkMemoryPropertyFlags typeFlags =
+      allocator.getMemoryProperties()
+          .memoryTypes[allocation.memoryTypeIndex]
+          .propertyFlags;
+  if (dirtyRanges.empty() ||
+      (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+    dirtyRanges.clear();
+    return VK_SUCCESS;
+  }
+
+  // non-coherent allocations start on an atom, so aligning offsets inside the
+  // allocation aligns them inside the memory block as well
+  VkDeviceSize atom = allocator.getNonCoherentAtomSize();
+  for (auto& [begin, end] : dirtyRanges) {
+    begin = begin / atom * atom;
+    end = std::min((end + atom - 1) / atom * atom, allocation.size);
+  }
+  std::sort(dirtyRanges.begin(), dirtyRanges.end());
+
+  std::vector<VkMappedMemoryRange> ranges{};
+  VkDeviceSize begin = dirtyRanges[0].first;
+  VkDeviceSize end = dirtyRanges[0].second;
+  auto addRange = [&]() {
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = allocation.offset + begin;
+    range.size = end - begin;
+    ranges.push_back(range);
+  };
+  for (size_t i = 1; i < dirtyRanges.size(); i++) {
+    if (dirtyRanges[i].first <= end) {
+      end = std::max(end, dirtyRanges[i].second);
+    } else {
+      addRange();
+      begin = dirtyRanges[i].first;
+      end = dirtyRanges[i].second;
+    }
+  }
+  addRange();
+  dirtyRanges.clear();
+
+  return vkFlushMappedMemoryRanges(lveDevice.device(),
+                                   static_cast<uint32_t>(ranges.size()),
+                                   ranges.data());
 }
 
 /**
@@ -112,11 +204,8 @@ void LveBuffer::writeToBuffer(void* data, VkDeviceSize size,
  * @return VkResult of the flush call
  */
 VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange =
+      lveDevice.allocator().mappedRange(allocation, size, offset);
   return vkFlushMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
@@ -132,11 +221,8 @@ VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult LveBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange =
+      lveDevice.allocator().mappedRange(allocation, size, offset);
   return vkInvalidateMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
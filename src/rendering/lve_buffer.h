@@ -2,6 +2,10 @@
 
 #include "lve_device.h"
 
+// std
+#include <utility>
+#include <vector>
+
 namespace lve {
 
 class LveBuffer {
@@ -22,16 +26,23 @@ public:
   VkDescriptorBufferInfo descriptorInfo(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
   VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
+  // Dirty tracking: writes record the byte ranges they touched, flushDirty()
+  // flushes all of them with a single call
+  void enableDirtyTracking(bool enabled = true);
+  void markDirty(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+  VkResult flushDirty();
+
   void writeToIndex(void* data, int index);
   VkResult flushIndex(int index);
   VkDescriptorBufferInfo descriptorInfoForIndex(int index);
   VkResult invalidateIndex(int index);
 
   [[nodiscard]] VkBuffer getBuffer() const { return buffer; }
+  [[nodiscard]] const LveAllocation& getAllocation() const { return allocation; }
   [[nodiscard]] void* getMappedMemory() const { return mapped; }
   [[nodiscard]] uint32_t getInstanceCount() const { return instanceCount; }
   [[nodiscard]] VkDeviceSize getInstanceSize() const { return instanceSize; }
-  [[nodiscard]] VkDeviceSize getAlignmentSize() const { return instanceSize; }
+  [[nodiscard]] VkDeviceSize getAlignmentSize() const { return alignmentSize; }
   [[nodiscard]] VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
   [[nodiscard]] VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
   [[nodiscard]] VkDeviceSize getBufferSize() const { return bufferSize; }
@@ -42,7 +53,7 @@ private:
   LveDevice& lveDevice;
   void* mapped = nullptr;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  LveAllocation allocation{};
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
@@ -50,6 +61,10 @@ private:
   VkDeviceSize alignmentSize;
   VkBufferUsageFlags usageFlags;
   VkMemoryPropertyFlags memoryPropertyFlags;
+
+  bool trackDirty = false;
+  // [begin, end) byte ranges written since the last flushDirty()
+  std::vector<std::pair<VkDeviceSize, VkDeviceSize>> dirtyRanges;
 };
 
 } // namespace lve
@@ -0,0 +1,50 @@
+#include "lve_deletion_queue.h"
+
+namespace lve {
+
+LveDeletionQueue::LveDeletionQueue(uint32_t frameCount) : frameCount{frameCount} {}
+
+LveDeletionQueue::~LveDeletionQueue() { flush(); }
+
+void LveDeletionQueue::push(std::function<void()> deleter) {
+  std::lock_guard<std::mutex> lock{mutex};
+  pending.push_back({std::move(deleter), frameCount});
+}
+
+void LveDeletionQueue::beginFrame() {
+  // deleters may push again, those go to the back with a full count
+  std::vector<PendingDeletion> due{};
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (--it->framesLeft == 0) {
+        due.push_back(std::move(*it));
+        it = pending.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto& deletion : due) {
+    deletion.deleter();
+  }
+}
+
+void LveDeletionQueue::flush() {
+  while (true) {
+    std::vector<PendingDeletion> deletions{};
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      deletions = std::move(pending);
+      pending.clear();
+    }
+    if (deletions.empty()) {
+      return;
+    }
+    for (auto& deletion : deletions) {
+      deletion.deleter();
+    }
+  }
+}
+
+} // namespace lve
@@ -0,0 +1,43 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Defers destroying resources that frames still in flight may use, e.g. a pipeline or mesh that
+ * was replaced while the app keeps rendering.
+ *
+ * Deleters run once frameCount more frames have begun, at which point every frame recorded before
+ * the push has completed. beginFrame() has to be called after the frame's fence was waited for.
+ * push() may be called from any thread, deleters run on the thread calling beginFrame().
+ */
+class LveDeletionQueue {
+public:
+  explicit LveDeletionQueue(uint32_t frameCount);
+  ~LveDeletionQueue();
+
+  LveDeletionQueue(const LveDeletionQueue&) = delete;
+  LveDeletionQueue& operator=(const LveDeletionQueue&) = delete;
+
+  void push(std::function<void()> deleter);
+  void beginFrame();
+  // runs every deleter right away, the device has to be idle
+  void flush();
+
+private:
+  struct PendingDeletion {
+    std::function<void()> deleter;
+    uint32_t framesLeft;
+  };
+
+  uint32_t frameCount;
+  std::mutex mutex;
+  std::vector<PendingDeletion> pending{};
+};
+
+} // namespace lve
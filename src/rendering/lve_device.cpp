@@ -1,8 +1,15 @@
 #include "lve_device.h"
+#include "lve_deletion_queue.h"
+#include "lve_geometry_arena.h"
+#include "lve_staging_ring.h"
+#include "lve_swapchain.h"
 
 // std headers
+#include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
@@ -48,9 +55,29 @@ LveDevice::LveDevice(LveWindow& window) : window{window} {
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
+  allocator_ = std::make_unique<LveAllocator>(device_, physicalDevice);
+  stagingRing_ = std::make_unique<LveStagingRing>(*this);
+  geometryArena_ = std::make_unique<LveGeometryArena>(*this);
+  deletionQueue_ = std::make_unique<LveDeletionQueue>(LveSwapchain::MAX_FRAMES_IN_FLIGHT);
 }
 
 LveDevice::~LveDevice() {
+  // deferred deleters may still free geometry or destroy pipelines
+  deletionQueue_.reset();
+  stagingRing_.reset();
+  if (!pendingUploads.empty()) {
+    waitForUpload({pendingUploads.back().value});
+  }
+  geometryArena_.reset();
+  for (auto fence : freeUploadFences) {
+    vkDestroyFence(device_, fence, nullptr);
+  }
+  for (auto semaphore : freeUploadSemaphores) {
+    vkDestroySemaphore(device_, semaphore, nullptr);
+  }
+  allocator_.reset();
+  vkDestroyCommandPool(device_, acquireCommandPool, nullptr);
+  vkDestroyCommandPool(device_, transferCommandPool, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -80,6 +107,11 @@ void LveDevice::createInstance() {
   createInfo.pApplicationInfo = &appInfo;
 
   auto extensions = getRequiredExtensions();
+  // needed to query VK_EXT_memory_budget on a 1.0 instance
+  if (isInstanceExtensionAvailable(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    physicalDeviceProperties2Enabled = true;
+  }
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
   createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -100,6 +132,11 @@ void LveDevice::createInstance() {
   }
 
   hasGflwRequiredInstanceExtensions();
+
+  if (physicalDeviceProperties2Enabled) {
+    getPhysicalDeviceMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)
+        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+  }
 }
 
 void LveDevice::pickPhysicalDevice() {
@@ -129,9 +166,11 @@ void LveDevice::pickPhysicalDevice() {
 
 void LveDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+  queueFamilies_ = indices;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily,
+                                            indices.transferFamily};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -143,8 +182,14 @@ void LveDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // optional, indirect draws are issued one by one without it
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  multiDrawIndirectEnabled = supportedFeatures.multiDrawIndirect == VK_TRUE;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -152,9 +197,23 @@ void LveDevice::createLogicalDevice() {
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  std::vector<const char*> extensions = deviceExtensions;
+  if (getPhysicalDeviceMemoryProperties2 != nullptr &&
+      isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    memoryBudgetEnabled = true;
+  }
+  // culled indirect draws are only compacted if they can be issued in a single call
+  bool drawIndirectCountEnabled =
+      multiDrawIndirectEnabled &&
+      isDeviceExtensionAvailable(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (drawIndirectCountEnabled) {
+    extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // might not really be necessary anymore because device specific validation
   // layers have been deprecated
@@ -169,8 +228,14 @@ void LveDevice::createLogicalDevice() {
     throw std::runtime_error("failed to create logical device!");
   }
 
+  if (drawIndirectCountEnabled) {
+    drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+        device_, "vkCmdDrawIndexedIndirectCountKHR");
+  }
+
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 }
 
 void LveDevice::createCommandPool() {
@@ -185,6 +250,19 @@ void LveDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &acquireCommandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create acquire command pool!");
+  }
+
+  poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer command pool!");
+  }
+}
+
+void LveDevice::waitIdle() {
+  std::lock_guard<std::mutex> lock{queueMutex_};
+  vkDeviceWaitIdle(device_);
 }
 
 void LveDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -308,6 +386,34 @@ bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   return requiredExtensions.empty();
 }
 
+bool LveDevice::isInstanceExtensionAvailable(const char* extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+  for (const auto& extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LveDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+  for (const auto& extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
   QueueFamilyIndices indices;
 
@@ -319,23 +425,33 @@ QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto& queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT &&
+        !indices.graphicsFamilyHasValue) {
       indices.graphicsFamily = i;
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
+    if (queueFamily.queueCount > 0 && presentSupport && !indices.presentFamilyHasValue) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
     }
-    if (indices.isComplete()) {
-      break;
+    // transfer-only families map to the copy engines and run alongside graphics work
+    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+        !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+        !indices.transferFamilyHasValue) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
     }
 
     i++;
   }
 
+  if (!indices.transferFamilyHasValue && indices.graphicsFamilyHasValue) {
+    indices.transferFamily = indices.graphicsFamily;
+    indices.transferFamilyHasValue = true;
+  }
+
   return indices;
 }
 
@@ -393,30 +509,50 @@ uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags pr
 
 void LveDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                              VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                             VkDeviceMemory& bufferMemory) {
+                             LveAllocation& allocation, bool sharedWithTransferQueue) {
+  uint32_t queueFamilyIndices[] = {queueFamilies_.graphicsFamily, queueFamilies_.transferFamily};
+  bool concurrent =
+      sharedWithTransferQueue && queueFamilies_.transferFamily != queueFamilies_.graphicsFamily;
+
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (concurrent) {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = 2;
+    bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+  } else {
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
 
   if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to create vertex buffer!");
   }
+  if (concurrent) {
+    std::lock_guard<std::mutex> lock{uploadMutex};
+    concurrentBuffers.insert(buffer);
+  }
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  allocation = allocator_->allocate(memRequirements, memoryTypeIndex,
+                                    LveAllocator::ResourceKind::Buffer);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory!");
+  if (vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind buffer memory!");
   }
+}
 
-  vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+void LveDevice::destroyBuffer(VkBuffer buffer, LveAllocation& allocation) {
+  {
+    std::lock_guard<std::mutex> lock{uploadMutex};
+    concurrentBuffers.erase(buffer);
+  }
+  vkDestroyBuffer(device_, buffer, nullptr);
+  allocator_->free(allocation);
 }
 
 VkCommandBuffer LveDevice::beginSingleTimeCommands() {
@@ -445,12 +581,287 @@ void LveDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue_);
+  // only wait for this submission instead of draining the whole queue
+  VkFence fence;
+  {
+    std::lock_guard<std::mutex> lock{uploadMutex};
+    fence = acquireUploadFence();
+  }
+  {
+    std::lock_guard<std::mutex> lock{queueMutex_};
+    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+  }
+  vkWaitForFences(device_, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  vkResetFences(device_, 1, &fence);
+  {
+    std::lock_guard<std::mutex> lock{uploadMutex};
+    freeUploadFences.push_back(fence);
+  }
 
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
+/**
+ * Records upload commands on the transfer queue and submits them without waiting for them.
+ *
+ * With a dedicated transfer queue the destination buffers are released to the graphics queue
+ * family at the end of the copies and acquired again by a small graphics submission that waits on
+ * the transfer through a semaphore. Otherwise a barrier makes the copies visible to later
+ * graphics work.
+ *
+ * @param record Records the copies, called with the upload lock held since the command buffer
+ * belongs to the shared transfer command pool
+ * @param dstBuffers Every buffer written by the command buffer
+ *
+ * @return Ticket that completes once the buffers can be used by the graphics queue
+ */
+UploadTicket LveDevice::submitUploadCommands(const std::function<void(VkCommandBuffer)>& record,
+                                             const std::vector<VkBuffer>& dstBuffers,
+                                             const std::vector<VkImage>& dstImages) {
+  std::lock_guard<std::mutex> lock{uploadMutex};
+  collectCompletedUploads();
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = transferCommandPool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(device_, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffer!");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+  record(commandBuffer);
+
+  constexpr VkAccessFlags consumerAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                                           VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+                                           VK_ACCESS_SHADER_READ_BIT;
+  constexpr VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+  PendingUpload upload{};
+  upload.value = nextUploadValue++;
+  upload.transferCommandBuffer = commandBuffer;
+  upload.fence = acquireUploadFence();
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  bool sameFamily = queueFamilies_.transferFamily == queueFamilies_.graphicsFamily;
+  uint32_t srcFamily = sameFamily ? VK_QUEUE_FAMILY_IGNORED : queueFamilies_.transferFamily;
+  uint32_t dstFamily = sameFamily ? VK_QUEUE_FAMILY_IGNORED : queueFamilies_.graphicsFamily;
+
+  // buffers shared between both families need no ownership transfer, the semaphore between the
+  // submissions already makes the writes visible
+  std::vector<VkBufferMemoryBarrier> bufferBarriers{};
+  for (size_t i = 0; i < dstBuffers.size() && !sameFamily; i++) {
+    if (concurrentBuffers.count(dstBuffers[i]) != 0) {
+      continue;
+    }
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = dstBuffers[i];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    bufferBarriers.push_back(barrier);
+  }
+
+  // images leave the upload ready to be sampled, the layout change doubles as ownership transfer
+  std::vector<VkImageMemoryBarrier> imageBarriers(dstImages.size());
+  for (size_t i = 0; i < imageBarriers.size(); i++) {
+    imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarriers[i].srcQueueFamilyIndex = srcFamily;
+    imageBarriers[i].dstQueueFamilyIndex = dstFamily;
+    imageBarriers[i].image = dstImages[i];
+    imageBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarriers[i].subresourceRange.baseMipLevel = 0;
+    imageBarriers[i].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageBarriers[i].subresourceRange.baseArrayLayer = 0;
+    imageBarriers[i].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  }
+
+  if (sameFamily) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = consumerAccess;
+    for (auto& imageBarrier : imageBarriers) {
+      imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, consumerStages, 0, 1,
+                         &barrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()),
+                         imageBarriers.data());
+    vkEndCommandBuffer(commandBuffer);
+
+    // the transfer queue is the graphics queue here, which the swapchain submits to as well
+    {
+      std::lock_guard<std::mutex> queueLock{queueMutex_};
+      if (vkQueueSubmit(transferQueue_, 1, &submitInfo, upload.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload commands!");
+      }
+    }
+    pendingUploads.push_back(upload);
+    return {upload.value};
+  }
+
+  // release on the transfer queue
+  for (auto& barrier : bufferBarriers) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+  }
+  for (auto& barrier : imageBarriers) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+  }
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                       static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+  vkEndCommandBuffer(commandBuffer);
+
+  upload.semaphore = acquireUploadSemaphore();
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &upload.semaphore;
+  if (vkQueueSubmit(transferQueue_, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload commands!");
+  }
+
+  // acquire on the graphics queue, ordered after the transfer by the semaphore
+  allocInfo.commandPool = acquireCommandPool;
+  if (vkAllocateCommandBuffers(device_, &allocInfo, &upload.acquireCommandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload acquire command buffer!");
+  }
+  vkBeginCommandBuffer(upload.acquireCommandBuffer, &beginInfo);
+  for (auto& barrier : bufferBarriers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = consumerAccess;
+  }
+  for (auto& barrier : imageBarriers) {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+  vkCmdPipelineBarrier(upload.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       consumerStages, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()),
+                       bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()),
+                       imageBarriers.data());
+  vkEndCommandBuffer(upload.acquireCommandBuffer);
+
+  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkSubmitInfo acquireInfo{};
+  acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  acquireInfo.waitSemaphoreCount = 1;
+  acquireInfo.pWaitSemaphores = &upload.semaphore;
+  acquireInfo.pWaitDstStageMask = &waitStage;
+  acquireInfo.commandBufferCount = 1;
+  acquireInfo.pCommandBuffers = &upload.acquireCommandBuffer;
+  {
+    std::lock_guard<std::mutex> queueLock{queueMutex_};
+    if (vkQueueSubmit(graphicsQueue_, 1, &acquireInfo, upload.fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit upload acquire commands!");
+    }
+  }
+
+  pendingUploads.push_back(upload);
+  return {upload.value};
+}
+
+bool LveDevice::isUploadComplete(UploadTicket ticket) {
+  if (ticket.value <= completedUploadValue) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock{uploadMutex};
+  collectCompletedUploads();
+  return ticket.value <= completedUploadValue;
+}
+
+void LveDevice::waitForUpload(UploadTicket ticket) {
+  assert(ticket.value != UploadTicket::UNSUBMITTED &&
+         "Waiting for an upload that was never submitted");
+  std::lock_guard<std::mutex> lock{uploadMutex};
+  for (auto& upload : pendingUploads) {
+    if (upload.value > ticket.value) {
+      break;
+    }
+    if (!upload.done) {
+      vkWaitForFences(device_, 1, &upload.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+  }
+  collectCompletedUploads();
+}
+
+void LveDevice::collectCompletedUploads() {
+  for (auto& upload : pendingUploads) {
+    if (!upload.done) {
+      upload.done = vkGetFenceStatus(device_, upload.fence) == VK_SUCCESS;
+    }
+  }
+
+  // tickets complete in submission order, so only retire from the front
+  while (!pendingUploads.empty() && pendingUploads.front().done) {
+    auto& upload = pendingUploads.front();
+    vkFreeCommandBuffers(device_, transferCommandPool, 1, &upload.transferCommandBuffer);
+    if (upload.acquireCommandBuffer != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(device_, acquireCommandPool, 1, &upload.acquireCommandBuffer);
+    }
+    if (upload.semaphore != VK_NULL_HANDLE) {
+      freeUploadSemaphores.push_back(upload.semaphore);
+    }
+    vkResetFences(device_, 1, &upload.fence);
+    freeUploadFences.push_back(upload.fence);
+
+    completedUploadValue = upload.value;
+    pendingUploads.pop_front();
+  }
+}
+
+VkFence LveDevice::acquireUploadFence() {
+  if (!freeUploadFences.empty()) {
+    VkFence fence = freeUploadFences.back();
+    freeUploadFences.pop_back();
+    return fence;
+  }
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkFence fence;
+  if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload fence!");
+  }
+  return fence;
+}
+
+VkSemaphore LveDevice::acquireUploadSemaphore() {
+  if (!freeUploadSemaphores.empty()) {
+    VkSemaphore semaphore = freeUploadSemaphores.back();
+    freeUploadSemaphores.pop_back();
+    return semaphore;
+  }
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  VkSemaphore semaphore;
+  if (vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload semaphore!");
+  }
+  return semaphore;
+}
+
 void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -487,7 +898,7 @@ void LveDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width
 
 void LveDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo,
                                     VkMemoryPropertyFlags properties, VkImage& image,
-                                    VkDeviceMemory& imageMemory) {
+                                    LveAllocation& allocation) {
   if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
     throw std::runtime_error("failed to create image!");
   }
@@ -495,17 +906,148 @@ void LveDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo,
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  // linear images are laid out like buffers, only optimal tiling needs its own blocks
+  auto kind = imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? LveAllocator::ResourceKind::Buffer
+                                                          : LveAllocator::ResourceKind::Image;
+  uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+  allocation = allocator_->allocate(memRequirements, memoryTypeIndex, kind);
 
-  if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate image memory!");
+  if (vkBindImageMemory(device_, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+    throw std::runtime_error("failed to bind image memory!");
   }
+}
 
-  if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS) {
-    throw std::runtime_error("failed to bind image memory!");
+void LveDevice::destroyImage(VkImage image, LveAllocation& allocation) {
+  vkDestroyImage(device_, image, nullptr);
+  allocator_->free(allocation);
+}
+
+/**
+ * Returns budget and usage of every memory heap. Without VK_EXT_memory_budget the budget is
+ * assumed to be 80% of the heap and usage is what the engine itself has allocated
+ */
+std::vector<LveHeapBudget> LveDevice::getMemoryBudget() {
+  const auto& memoryProperties = allocator_->getMemoryProperties();
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  if (memoryBudgetEnabled) {
+    VkPhysicalDeviceMemoryProperties2KHR properties2{};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+    properties2.pNext = &budgetProperties;
+    getPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+  }
+
+  std::vector<LveHeapBudget> budgets(memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    auto& heap = budgets[i];
+    heap.heapIndex = i;
+    heap.heapSize = memoryProperties.memoryHeaps[i].size;
+    heap.deviceLocal =
+        (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    heap.engine = allocator_->getHeapUsage(i);
+
+    if (memoryBudgetEnabled) {
+      heap.budget = budgetProperties.heapBudget[i];
+      heap.usage = budgetProperties.heapUsage[i];
+    } else {
+      heap.budget = heap.heapSize / 10 * 8;
+      heap.usage = heap.engine.blockBytes;
+    }
+  }
+  return budgets;
+}
+
+/**
+ * Returns the budget queried in the last beginFrame. The driver's usage figure is only refreshed
+ * once per frame, the engine's own block bytes allocated or freed since are added to it
+ */
+std::vector<LveHeapBudget> LveDevice::getCachedMemoryBudget() {
+  if (cachedBudget.empty()) {
+    cachedBudget = getMemoryBudget();
+  }
+
+  std::vector<LveHeapBudget> budgets = cachedBudget;
+  for (auto& heap : budgets) {
+    LveHeapUsage engine = allocator_->getHeapUsage(heap.heapIndex);
+    heap.usage = heap.usage + engine.blockBytes >= heap.engine.blockBytes
+                     ? heap.usage + engine.blockBytes - heap.engine.blockBytes
+                     : 0;
+    heap.engine = engine;
+  }
+  return budgets;
+}
+
+uint32_t LveDevice::addEvictionHandler(EvictionHandler handler) {
+  uint32_t id = nextEvictionHandlerId++;
+  evictionHandlers.emplace_back(id, std::move(handler));
+  return id;
+}
+
+void LveDevice::removeEvictionHandler(uint32_t id) {
+  evictionHandlers.erase(std::remove_if(evictionHandlers.begin(), evictionHandlers.end(),
+                                        [id](const auto& entry) { return entry.first == id; }),
+                         evictionHandlers.end());
+}
+
+void LveDevice::beginFrame() {
+  deletionQueue_->beginFrame();
+  cachedBudget = getMemoryBudget();
+  enforceMemoryBudget();
+}
+
+/**
+ * Asks the eviction handlers to bring every heap back below EVICTION_THRESHOLD of its budget.
+ * Memory handlers released earlier still counts as freed while its deferred frees are pending,
+ * so the same pressure doesn't evict twice
+ */
+void LveDevice::enforceMemoryBudget() {
+  // handlers free (and may create) resources themselves, which must not recurse into here
+  if (evictionHandlers.empty() || evicting) {
+    return;
+  }
+  evicting = true;
+
+  auto budgets = getCachedMemoryBudget();
+  pendingEvictionBytes.resize(budgets.size(), 0);
+  for (const auto& heap : budgets) {
+    auto limit = static_cast<VkDeviceSize>(static_cast<double>(heap.budget) * EVICTION_THRESHOLD);
+    VkDeviceSize pending = pendingEvictionBytes[heap.heapIndex];
+    VkDeviceSize usage = heap.usage > pending ? heap.usage - pending : 0;
+    if (usage <= limit) {
+      continue;
+    }
+
+    VkDeviceSize bytesToFree = usage - limit;
+    VkDeviceSize released = 0;
+    for (auto& [id, handler] : evictionHandlers) {
+      released += handler(heap, bytesToFree - released);
+      if (released >= bytesToFree) {
+        break;
+      }
+    }
+
+    // pushed after the handlers' own deferred frees, so it runs together with them
+    if (released > 0) {
+      pendingEvictionBytes[heap.heapIndex] += released;
+      deletionQueue_->push([this, heapIndex = heap.heapIndex, released]() {
+        pendingEvictionBytes[heapIndex] -= released;
+      });
+    }
+  }
+
+  evicting = false;
+}
+
+void LveDevice::printMemoryBudget() {
+  std::cout << "memory budget (" << (memoryBudgetEnabled ? "VK_EXT_memory_budget" : "estimated")
+            << "):" << std::endl;
+  for (const auto& heap : getMemoryBudget()) {
+    std::cout << "\theap " << heap.heapIndex << (heap.deviceLocal ? " (device local)" : "")
+              << ": " << heap.usage / (1024 * 1024) << " / " << heap.budget / (1024 * 1024)
+              << " MiB, engine " << heap.engine.usedBytes / (1024 * 1024) << " MiB used in "
+              << heap.engine.blockBytes / (1024 * 1024) << " MiB blocks, peak "
+              << heap.engine.peakBlockBytes / (1024 * 1024) << " MiB" << std::endl;
   }
 }
 
@@ -1,12 +1,24 @@
 #pragma once
 
+#include "lve_allocator.h"
 #include "lve_window.h"
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace lve {
 
+class LveDeletionQueue;
+class LveGeometryArena;
+class LveStagingRing;
+
 struct SwapchainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -16,12 +28,34 @@ struct SwapchainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // a transfer-only family if the device has one, the graphics family otherwise
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
 
   [[nodiscard]] bool isComplete() const { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
+// Identifies a submission made with LveDevice::submitUploadCommands, tickets complete in order
+struct UploadTicket {
+  // handed out for uploads that are recorded but not submitted yet, never completes
+  static constexpr uint64_t UNSUBMITTED = std::numeric_limits<uint64_t>::max();
+
+  uint64_t value = 0;
+};
+
+// Usage of one memory heap. budget and usage come from VK_EXT_memory_budget when the device
+// supports it and are estimated from the engine's own allocations otherwise
+struct LveHeapBudget {
+  uint32_t heapIndex = 0;
+  bool deviceLocal = false;
+  VkDeviceSize heapSize = 0;
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+  LveHeapUsage engine{};
+};
+
 class LveDevice {
 public:
 #ifdef NDEBUG
@@ -53,6 +87,15 @@ public:
 
   VkQueue presentQueue() { return presentQueue_; }
 
+  VkQueue transferQueue() { return transferQueue_; }
+
+  // Uploads submit to the graphics queue from whichever thread records them, so every other
+  // submission to the graphics or present queue has to hold this lock as well
+  std::mutex& queueMutex() { return queueMutex_; }
+
+  // vkDeviceWaitIdle, which needs exclusive access to all queues
+  void waitIdle();
+
   SwapchainSupportDetails getSwapchainSupport() { return querySwapchainSupport(physicalDevice); }
 
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -62,21 +105,93 @@ public:
   VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
                                VkFormatFeatureFlags features);
 
+  LveAllocator& allocator() { return *allocator_; }
+
+  LveStagingRing& stagingRing() { return *stagingRing_; }
+
+  LveGeometryArena& geometryArena() { return *geometryArena_; }
+
+  // destroys replaced resources once no frame in flight uses them any more
+  LveDeletionQueue& deletionQueue() { return *deletionQueue_; }
+
   // Buffer Helper Functions
+  // sharedWithTransferQueue creates the buffer with concurrent sharing, for buffers that are
+  // partially updated by uploads while the graphics queue keeps reading the rest of them
   void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                    VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+                    VkBuffer& buffer, LveAllocation& allocation,
+                    bool sharedWithTransferQueue = false);
+
+  void destroyBuffer(VkBuffer buffer, LveAllocation& allocation);
 
   VkCommandBuffer beginSingleTimeCommands();
 
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
+  // Async uploads: commands are recorded on the transfer queue, ownership of the destination
+  // buffers and images is handed to the graphics queue before the ticket completes. Images are
+  // expected in TRANSFER_DST_OPTIMAL and end up in SHADER_READ_ONLY_OPTIMAL. Safe to call from
+  // any thread
+  UploadTicket submitUploadCommands(const std::function<void(VkCommandBuffer)>& record,
+                                    const std::vector<VkBuffer>& dstBuffers,
+                                    const std::vector<VkImage>& dstImages = {});
+
+  bool isUploadComplete(UploadTicket ticket);
+
+  void waitForUpload(UploadTicket ticket);
+
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
   void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
                          uint32_t layerCount);
 
   void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
-                           VkImage& image, VkDeviceMemory& imageMemory);
+                           VkImage& image, LveAllocation& allocation);
+
+  void destroyImage(VkImage image, LveAllocation& allocation);
+
+  // Memory budget: handlers are asked to free memory of a heap, e.g. by evicting or downgrading
+  // cold resources, once its usage crosses EVICTION_THRESHOLD of the budget. They return the
+  // number of bytes they released, which count as freed until the deletion queue has run.
+  // Handlers are only called from beginFrame, on the main thread.
+  using EvictionHandler =
+      std::function<VkDeviceSize(const LveHeapBudget& heap, VkDeviceSize bytesToFree)>;
+
+  static constexpr float EVICTION_THRESHOLD = 0.9f;
+
+  // queries the driver, see getCachedMemoryBudget for the figures of the current frame
+  std::vector<LveHeapBudget> getMemoryBudget();
+
+  // budget as of the last beginFrame, usage includes the engine's allocations since then
+  std::vector<LveHeapBudget> getCachedMemoryBudget();
+
+  bool hasMemoryBudgetExtension() const { return memoryBudgetEnabled; }
+
+  bool hasMultiDrawIndirect() const { return multiDrawIndirectEnabled; }
+
+  // VK_KHR_draw_indirect_count, only enabled together with multiDrawIndirect
+  bool hasDrawIndirectCount() const { return drawIndexedIndirectCount != nullptr; }
+
+  // requires hasDrawIndirectCount
+  void cmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                   VkDeviceSize offset, VkBuffer countBuffer,
+                                   VkDeviceSize countBufferOffset, uint32_t maxDrawCount,
+                                   uint32_t stride) const {
+    drawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset,
+                             maxDrawCount, stride);
+  }
+
+  // @return id for removeEvictionHandler
+  uint32_t addEvictionHandler(EvictionHandler handler);
+
+  void removeEvictionHandler(uint32_t id);
+
+  // call once per frame after the frame's fence was waited for: runs due deletions, refreshes the
+  // cached memory budget and enforces it
+  void beginFrame();
+
+  void enforceMemoryBudget();
+
+  void printMemoryBudget();
 
   VkPhysicalDeviceProperties properties;
 
@@ -93,6 +208,13 @@ private:
 
   void createCommandPool();
 
+  // called with uploadMutex held
+  void collectCompletedUploads();
+
+  VkFence acquireUploadFence();
+
+  VkSemaphore acquireUploadSemaphore();
+
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
 
@@ -108,6 +230,10 @@ private:
 
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+  bool isInstanceExtensionAvailable(const char* extensionName);
+
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
+
   SwapchainSupportDetails querySwapchainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -115,11 +241,53 @@ private:
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   LveWindow& window;
   VkCommandPool commandPool;
+  VkCommandPool transferCommandPool;
+  // graphics family pool for the acquire half of uploads, commandPool belongs to the main thread
+  VkCommandPool acquireCommandPool;
 
   VkDevice device_;
   VkSurfaceKHR surface_;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  QueueFamilyIndices queueFamilies_;
+  std::unique_ptr<LveAllocator> allocator_;
+  std::unique_ptr<LveStagingRing> stagingRing_;
+  std::unique_ptr<LveGeometryArena> geometryArena_;
+  std::unique_ptr<LveDeletionQueue> deletionQueue_;
+  std::unordered_set<VkBuffer> concurrentBuffers;
+  std::mutex queueMutex_;
+
+  bool physicalDeviceProperties2Enabled = false;
+  bool memoryBudgetEnabled = false;
+  bool multiDrawIndirectEnabled = false;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
+  PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;
+  std::vector<std::pair<uint32_t, EvictionHandler>> evictionHandlers;
+  uint32_t nextEvictionHandlerId = 0;
+  bool evicting = false;
+  std::vector<LveHeapBudget> cachedBudget;
+  // bytes handlers released per heap whose deferred frees haven't run yet
+  std::vector<VkDeviceSize> pendingEvictionBytes;
+
+  struct PendingUpload {
+    uint64_t value;
+    VkFence fence;
+    VkCommandBuffer transferCommandBuffer;
+    VkCommandBuffer acquireCommandBuffer;
+    VkSemaphore semaphore;
+    bool done;
+  };
+
+  // guards the upload state below, the transfer and acquire command pools and concurrentBuffers.
+  // Taken before queueMutex_ where both are needed
+  std::mutex uploadMutex;
+  std::deque<PendingUpload> pendingUploads;
+  std::vector<VkFence> freeUploadFences;
+  std::vector<VkSemaphore> freeUploadSemaphores;
+  uint64_t nextUploadValue = 1;
+  // read without the lock to answer isUploadComplete for finished tickets
+  std::atomic<uint64_t> completedUploadValue{0};
 
   const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -0,0 +1,69 @@
+#include "lve_frame_allocator.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+LveFrameAllocator::LveFrameAllocator(LveDevice& device, uint32_t frameCount,
+                                     VkDeviceSize frameSize)
+    : alignment{std::max<VkDeviceSize>(
+          device.properties.limits.minUniformBufferOffsetAlignment, 1)} {
+  buffer = std::make_unique<LveBuffer>(device, frameSize, frameCount,
+                                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, alignment);
+  if (buffer->map() != VK_SUCCESS) {
+    throw std::runtime_error("failed to map frame allocator buffer!");
+  }
+  this->frameSize = buffer->getAlignmentSize();
+}
+
+/**
+ * Drops every slice handed out the last time frameIndex was recorded
+ *
+ * @note Call only after the fence of frameIndex has been waited on (see LveRenderer::beginFrame)
+ */
+void LveFrameAllocator::beginFrame(int frameIndex) {
+  frameStart = frameSize * static_cast<VkDeviceSize>(frameIndex);
+  head = frameStart;
+}
+
+/**
+ * Bumps an aligned slice off the current frame's region
+ *
+ * @return Slice whose dynamicOffset selects it in descriptors created from descriptorInfo()
+ */
+LveFrameSlice LveFrameAllocator::allocate(VkDeviceSize size) {
+  VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+  // descriptors always read bindingRange bytes, which must not spill into the next frame
+  if (offset + std::max(size, bindingRange) > frameStart + frameSize) {
+    throw std::runtime_error("frame allocator is out of memory!");
+  }
+  head = offset + size;
+
+  LveFrameSlice slice{};
+  slice.data = static_cast<char*>(buffer->getMappedMemory()) + offset;
+  slice.size = size;
+  slice.dynamicOffset = static_cast<uint32_t>(offset);
+  return slice;
+}
+
+/**
+ * Flushes everything written to the current frame's slices in a single call
+ */
+VkResult LveFrameAllocator::flush() {
+  if (head == frameStart) {
+    return VK_SUCCESS;
+  }
+  return buffer->flush(head - frameStart, frameStart);
+}
+
+VkDescriptorBufferInfo LveFrameAllocator::descriptorInfo(VkDeviceSize range) {
+  assert(range <= frameSize && "Descriptor range exceeds the frame size");
+  bindingRange = std::max(bindingRange, range);
+  return buffer->descriptorInfo(range, 0);
+}
+
+} // namespace lve
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "lve_buffer.h"
+
+// std
+#include <cstring>
+#include <memory>
+
+namespace lve {
+
+// Part of the current frame's memory, bound through a dynamic offset
+struct LveFrameSlice {
+  void* data = nullptr;
+  VkDeviceSize size = 0;
+  uint32_t dynamicOffset = 0;
+};
+
+/*
+ * Linear allocator for transient per-frame data like uniform buffers.
+ *
+ * Each frame in flight owns a fixed region of one persistently mapped buffer. Slices are bumped
+ * off the region of the current frame and all of them are dropped at once when the frame comes
+ * around again, which is only safe once the renderer has waited for that frame's fence.
+ *
+ * Descriptors point at the start of the buffer (see descriptorInfo) and select a slice with the
+ * dynamic offset of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding.
+ */
+class LveFrameAllocator {
+public:
+  static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 1024 * 1024;
+
+  LveFrameAllocator(LveDevice& device, uint32_t frameCount,
+                    VkDeviceSize frameSize = DEFAULT_FRAME_SIZE);
+
+  LveFrameAllocator(const LveFrameAllocator&) = delete;
+  LveFrameAllocator& operator=(const LveFrameAllocator&) = delete;
+
+  void beginFrame(int frameIndex);
+  LveFrameSlice allocate(VkDeviceSize size);
+  VkResult flush();
+
+  template <typename T>
+  LveFrameSlice push(const T& data) {
+    LveFrameSlice slice = allocate(sizeof(T));
+    std::memcpy(slice.data, &data, sizeof(T));
+    return slice;
+  }
+
+  VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range);
+
+  [[nodiscard]] VkBuffer getBuffer() const { return buffer->getBuffer(); }
+  [[nodiscard]] VkDeviceSize getUsedBytes() const { return head - frameStart; }
+
+private:
+  std::unique_ptr<LveBuffer> buffer;
+  VkDeviceSize alignment;
+  VkDeviceSize frameSize;
+  // largest range a descriptor reads behind a dynamic offset
+  VkDeviceSize bindingRange = 0;
+
+  VkDeviceSize frameStart = 0;
+  VkDeviceSize head = 0;
+};
+
+} // namespace lve
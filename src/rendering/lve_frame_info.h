@@ -2,7 +2,8 @@
 #pragma once
 
 #include "../lve_camera.h"
-#include "../lve_game_object.h"
+#include "../lve_scene.h"
+#include "lve_frame_allocator.h"
 #include <vulkan/vulkan.h>
 
 namespace lve {
@@ -27,8 +28,13 @@ struct FrameInfo {
   float frameTime;
   VkCommandBuffer commandBuffer;
   LveCamera& camera;
+  // size of the render target in pixels
+  VkExtent2D extent;
   VkDescriptorSet globalDescriptorSet;
-  LveGameObject::Map& gameObjects;
+  // dynamic offset of this frame's GlobalUbo in globalDescriptorSet
+  uint32_t globalUboOffset;
+  LveFrameAllocator& frameAllocator;
+  LveScene& scene;
 };
 
 } // namespace lve
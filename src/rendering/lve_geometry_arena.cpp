@@ -0,0 +1,260 @@
+#include "lve_geometry_arena.h"
+
+// std
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+LveGeometryArena::LveGeometryArena(LveDevice& device, VkDeviceSize vertexCapacity,
+                                   VkDeviceSize indexCapacity, VkDeviceSize meshletCapacity)
+    : lveDevice{device}, vertexCapacity{vertexCapacity} {
+  for (size_t i = 0; i < indexBuffers.size(); i++) {
+    lveDevice.createBuffer(indexCapacity,
+                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffers[i],
+                           indexAllocations[i], true);
+    indexRanges[i].capacity = indexCapacity;
+    indexRanges[i].ranges[0] = indexCapacity;
+  }
+  lveDevice.createBuffer(meshletCapacity,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletBuffer, meshletAllocation,
+                         true);
+  meshletRanges.capacity = meshletCapacity;
+  meshletRanges.ranges[0] = meshletCapacity;
+}
+
+LveGeometryArena::~LveGeometryArena() {
+  assert(getUsedVertexBytes() == 0 && getUsedIndexBytes() == 0 && meshletRanges.used == 0 &&
+         "Destroying geometry arena with live meshes");
+  for (uint32_t i = 0; i < vertexPoolCount; i++) {
+    lveDevice.destroyBuffer(vertexPools[i].positionBuffer, vertexPools[i].positionAllocation);
+    lveDevice.destroyBuffer(vertexPools[i].attributeBuffer, vertexPools[i].attributeAllocation);
+  }
+  for (size_t i = 0; i < indexBuffers.size(); i++) {
+    lveDevice.destroyBuffer(indexBuffers[i], indexAllocations[i]);
+  }
+  lveDevice.destroyBuffer(meshletBuffer, meshletAllocation);
+}
+
+/**
+ * Reserves room for vertexCount vertices in both streams of the layout's vertex pool
+ *
+ * @return Span whose first element is the vertexOffset of the mesh's draws
+ */
+LveVertexSpan LveGeometryArena::allocateVertices(uint32_t vertexCount,
+                                                 const LveVertexLayout& layout) {
+  assert(vertexCount > 0 && layout.positionStride > 0 && layout.attributeStride > 0 &&
+         "Allocating an empty vertex span");
+
+  LveVertexSpan span{};
+  std::lock_guard<std::mutex> lock{mutex};
+  span.pool = findVertexPool(layout);
+  VkDeviceSize first = 0;
+  if (!allocate(vertexPools[span.pool].ranges, vertexCount, 1, first)) {
+    throw std::runtime_error("geometry arena is out of vertex memory!");
+  }
+  span.first = static_cast<uint32_t>(first);
+  span.count = vertexCount;
+  span.positionOffset = first * layout.positionStride;
+  span.attributeOffset = first * layout.attributeStride;
+  span.size = static_cast<VkDeviceSize>(vertexCount) *
+              (layout.positionStride + layout.attributeStride);
+  return span;
+}
+
+/**
+ * Reserves room for indexCount indices in the index buffer of indexType
+ *
+ * @return Span whose first element is the firstIndex of the mesh's draws
+ */
+LveGeometrySpan LveGeometryArena::allocateIndices(uint32_t indexCount, VkIndexType indexType) {
+  assert(indexCount > 0 && "Allocating an empty index span");
+
+  VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+  LveGeometrySpan span{};
+  span.size = indexCount * indexSize;
+  span.count = indexCount;
+  std::lock_guard<std::mutex> lock{mutex};
+  if (!allocate(indexRanges[indexBufferSlot(indexType)], span.size, indexSize, span.offset)) {
+    throw std::runtime_error("geometry arena is out of index memory!");
+  }
+  span.first = static_cast<uint32_t>(span.offset / indexSize);
+  return span;
+}
+
+/**
+ * Reserves room for meshletCount meshlets in the meshlet storage buffer
+ *
+ * @return Span whose first element is the index of the first meshlet in the buffer
+ */
+LveGeometrySpan LveGeometryArena::allocateMeshlets(uint32_t meshletCount, uint32_t meshletSize) {
+  assert(meshletCount > 0 && meshletSize > 0 && "Allocating an empty meshlet span");
+
+  LveGeometrySpan span{};
+  span.size = static_cast<VkDeviceSize>(meshletCount) * meshletSize;
+  span.count = meshletCount;
+  std::lock_guard<std::mutex> lock{mutex};
+  if (!allocate(meshletRanges, span.size, meshletSize, span.offset)) {
+    throw std::runtime_error("geometry arena is out of meshlet memory!");
+  }
+  span.first = static_cast<uint32_t>(span.offset / meshletSize);
+  return span;
+}
+
+void LveGeometryArena::freeVertices(LveVertexSpan& span) {
+  if (!span.isValid()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  release(vertexPools[span.pool].ranges, span.first, span.count);
+  span = {};
+}
+
+void LveGeometryArena::freeIndices(LveGeometrySpan& span, VkIndexType indexType) {
+  if (!span.isValid()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  release(indexRanges[indexBufferSlot(indexType)], span.offset, span.size);
+  span = {};
+}
+
+void LveGeometryArena::freeMeshlets(LveGeometrySpan& span) {
+  if (!span.isValid()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{mutex};
+  release(meshletRanges, span.offset, span.size);
+  span = {};
+}
+
+void LveGeometryArena::bindVertices(VkCommandBuffer commandBuffer, uint32_t pool) const {
+  VkBuffer buffers[] = {vertexPools[pool].positionBuffer, vertexPools[pool].attributeBuffer};
+  VkDeviceSize offsets[] = {0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
+}
+
+void LveGeometryArena::bindPositions(VkCommandBuffer commandBuffer, uint32_t pool) const {
+  VkBuffer buffers[] = {vertexPools[pool].positionBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+}
+
+void LveGeometryArena::bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const {
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffers[indexBufferSlot(indexType)], 0, indexType);
+}
+
+VkDeviceSize LveGeometryArena::getUsedVertexBytes() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  VkDeviceSize used = 0;
+  for (uint32_t i = 0; i < vertexPoolCount; i++) {
+    const auto& pool = vertexPools[i];
+    used += pool.ranges.used * (pool.layout.positionStride + pool.layout.attributeStride);
+  }
+  return used;
+}
+
+VkDeviceSize LveGeometryArena::getUsedIndexBytes() const {
+  std::lock_guard<std::mutex> lock{mutex};
+  return indexRanges[0].used + indexRanges[1].used;
+}
+
+// called with the lock held, creates the layout's pool the first time it is used
+uint32_t LveGeometryArena::findVertexPool(const LveVertexLayout& layout) {
+  for (uint32_t i = 0; i < vertexPoolCount; i++) {
+    if (vertexPools[i].layout == layout) {
+      return i;
+    }
+  }
+  if (vertexPoolCount == MAX_VERTEX_POOLS) {
+    throw std::runtime_error("geometry arena has no vertex pool left for another layout!");
+  }
+
+  auto& pool = vertexPools[vertexPoolCount];
+  pool.layout = layout;
+  VkDeviceSize capacity = vertexCapacity / (layout.positionStride + layout.attributeStride);
+  lveDevice.createBuffer(capacity * layout.positionStride,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool.positionBuffer,
+                         pool.positionAllocation, true);
+  lveDevice.createBuffer(capacity * layout.attributeStride,
+                         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pool.attributeBuffer,
+                         pool.attributeAllocation, true);
+  pool.ranges.capacity = capacity;
+  pool.ranges.ranges[0] = capacity;
+  return vertexPoolCount++;
+}
+
+bool LveGeometryArena::allocate(FreeRanges& freeRanges, VkDeviceSize size,
+                                VkDeviceSize alignment, VkDeviceSize& offset) {
+  if (freeRanges.capacity - freeRanges.used < size) {
+    return false;
+  }
+
+  // best fit: pick the free range that leaves the smallest remainder
+  auto best = freeRanges.ranges.end();
+  VkDeviceSize bestRemainder = std::numeric_limits<VkDeviceSize>::max();
+  for (auto it = freeRanges.ranges.begin(); it != freeRanges.ranges.end(); ++it) {
+    VkDeviceSize alignedOffset = alignUp(it->first, alignment);
+    VkDeviceSize rangeEnd = it->first + it->second;
+    if (alignedOffset + size > rangeEnd) {
+      continue;
+    }
+    VkDeviceSize remainder = rangeEnd - (alignedOffset + size);
+    if (remainder < bestRemainder) {
+      best = it;
+      bestRemainder = remainder;
+      if (remainder == 0) {
+        break;
+      }
+    }
+  }
+
+  if (best == freeRanges.ranges.end()) {
+    return false;
+  }
+
+  VkDeviceSize rangeOffset = best->first;
+  VkDeviceSize rangeEnd = best->first + best->second;
+  offset = alignUp(rangeOffset, alignment);
+  freeRanges.ranges.erase(best);
+
+  if (offset > rangeOffset) {
+    freeRanges.ranges[rangeOffset] = offset - rangeOffset;
+  }
+  if (offset + size < rangeEnd) {
+    freeRanges.ranges[offset + size] = rangeEnd - (offset + size);
+  }
+  freeRanges.used += size;
+  return true;
+}
+
+void LveGeometryArena::release(FreeRanges& freeRanges, VkDeviceSize offset, VkDeviceSize size) {
+  freeRanges.used -= size;
+
+  // merge with the free ranges directly before and after
+  auto next = freeRanges.ranges.lower_bound(offset);
+  if (next != freeRanges.ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      freeRanges.ranges.erase(prev);
+    }
+  }
+  if (next != freeRanges.ranges.end() && offset + size == next->first) {
+    size += next->second;
+    freeRanges.ranges.erase(next);
+  }
+  freeRanges.ranges[offset] = size;
+}
+
+} // namespace lve
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "lve_device.h"
+
+// std
+#include <array>
+#include <map>
+#include <mutex>
+
+namespace lve {
+
+// A run of elements inside one of the arena's buffers
+struct LveGeometrySpan {
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // index of the first element when the whole buffer is bound
+  uint32_t first = 0;
+  uint32_t count = 0;
+
+  [[nodiscard]] bool isValid() const { return size != 0; }
+};
+
+// Strides of the position stream (binding 0) and attribute stream (binding 1) of a vertex format
+struct LveVertexLayout {
+  uint32_t positionStride = 0;
+  uint32_t attributeStride = 0;
+
+  bool operator==(const LveVertexLayout& other) const {
+    return positionStride == other.positionStride && attributeStride == other.attributeStride;
+  }
+};
+
+// A run of vertices in both streams of a vertex pool, element first of each stream belongs to the
+// same vertex. size counts the bytes of both streams
+struct LveVertexSpan {
+  uint32_t pool = 0;
+  VkDeviceSize positionOffset = 0;
+  VkDeviceSize attributeOffset = 0;
+  VkDeviceSize size = 0;
+  // vertexOffset of the mesh when the whole pool is bound
+  uint32_t first = 0;
+  uint32_t count = 0;
+
+  [[nodiscard]] bool isValid() const { return size != 0; }
+};
+
+/*
+ * Shared device local vertex and index buffers that every mesh is placed into, plus a storage
+ * buffer holding the meshlets that compute culling reads.
+ *
+ * Every vertex layout gets a pool of its own: a position and an attribute buffer whose vertices
+ * are allocated in lockstep, so both streams are indexed by the same vertexOffset. Pools are
+ * created the first time a layout is allocated. Each index width has a buffer of its own as well.
+ * Meshes are bound by binding the whole buffers once and selected through the firstIndex and
+ * vertexOffset of draw calls, draws only rebind when the vertex layout or index width changes.
+ *
+ * Spans may be allocated and freed from any thread. A freed span is reused right away, so spans
+ * that frames in flight may still read have to be freed through the deletion queue.
+ */
+class LveGeometryArena {
+public:
+  // per vertex pool, split between the two streams by their strides
+  static constexpr VkDeviceSize DEFAULT_VERTEX_CAPACITY = 64ull * 1024 * 1024;
+  // per index width
+  static constexpr VkDeviceSize DEFAULT_INDEX_CAPACITY = 16ull * 1024 * 1024;
+  static constexpr VkDeviceSize DEFAULT_MESHLET_CAPACITY = 8ull * 1024 * 1024;
+  static constexpr uint32_t MAX_VERTEX_POOLS = 4;
+
+  explicit LveGeometryArena(LveDevice& device,
+                            VkDeviceSize vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+                            VkDeviceSize indexCapacity = DEFAULT_INDEX_CAPACITY,
+                            VkDeviceSize meshletCapacity = DEFAULT_MESHLET_CAPACITY);
+  ~LveGeometryArena();
+
+  LveGeometryArena(const LveGeometryArena&) = delete;
+  LveGeometryArena& operator=(const LveGeometryArena&) = delete;
+
+  LveVertexSpan allocateVertices(uint32_t vertexCount, const LveVertexLayout& layout);
+  LveGeometrySpan allocateIndices(uint32_t indexCount, VkIndexType indexType);
+  LveGeometrySpan allocateMeshlets(uint32_t meshletCount, uint32_t meshletSize);
+  void freeVertices(LveVertexSpan& span);
+  void freeIndices(LveGeometrySpan& span, VkIndexType indexType);
+  void freeMeshlets(LveGeometrySpan& span);
+
+  // binds both streams of the pool to bindings 0 and 1
+  void bindVertices(VkCommandBuffer commandBuffer, uint32_t pool) const;
+  // binds only the position stream of the pool, for depth only pipelines
+  void bindPositions(VkCommandBuffer commandBuffer, uint32_t pool) const;
+  void bindIndices(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+
+  [[nodiscard]] VkBuffer getPositionBuffer(uint32_t pool) const {
+    return vertexPools[pool].positionBuffer;
+  }
+  [[nodiscard]] VkBuffer getAttributeBuffer(uint32_t pool) const {
+    return vertexPools[pool].attributeBuffer;
+  }
+  [[nodiscard]] VkBuffer getIndexBuffer(VkIndexType indexType) const {
+    return indexBuffers[indexBufferSlot(indexType)];
+  }
+  [[nodiscard]] VkBuffer getMeshletBuffer() const { return meshletBuffer; }
+  [[nodiscard]] VkDeviceSize getUsedVertexBytes() const;
+  [[nodiscard]] VkDeviceSize getUsedIndexBytes() const;
+
+private:
+  struct FreeRanges {
+    VkDeviceSize capacity = 0;
+    VkDeviceSize used = 0;
+    // offset -> size of every free range, adjacent ranges are always merged
+    std::map<VkDeviceSize, VkDeviceSize> ranges{};
+  };
+
+  // ranges count vertices, not bytes
+  struct VertexPool {
+    LveVertexLayout layout{};
+    VkBuffer positionBuffer = VK_NULL_HANDLE;
+    VkBuffer attributeBuffer = VK_NULL_HANDLE;
+    LveAllocation positionAllocation{};
+    LveAllocation attributeAllocation{};
+    FreeRanges ranges{};
+  };
+
+  static uint32_t indexBufferSlot(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+  }
+
+  uint32_t findVertexPool(const LveVertexLayout& layout);
+  static bool allocate(FreeRanges& freeRanges, VkDeviceSize size, VkDeviceSize alignment,
+                       VkDeviceSize& offset);
+  static void release(FreeRanges& freeRanges, VkDeviceSize offset, VkDeviceSize size);
+
+  LveDevice& lveDevice;
+  VkDeviceSize vertexCapacity;
+  // 16 and 32 bit indices
+  std::array<VkBuffer, 2> indexBuffers{};
+  std::array<LveAllocation, 2> indexAllocations{};
+  VkBuffer meshletBuffer = VK_NULL_HANDLE;
+  LveAllocation meshletAllocation{};
+  // guards the free ranges and vertexPoolCount
+  mutable std::mutex mutex;
+  // a pool never moves once created, so its buffers may be read without the lock
+  std::array<VertexPool, MAX_VERTEX_POOLS> vertexPools{};
+  uint32_t vertexPoolCount = 0;
+  std::array<FreeRanges, 2> indexRanges{};
+  FreeRanges meshletRanges{};
+};
+
+} // namespace lve
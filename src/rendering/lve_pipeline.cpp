@@ -1,39 +1,52 @@
 #include "lve_pipeline.h"
+#include "../lve_mapped_file.h"
 #include "../lve_model.h"
+#include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <fmt/printf.h>
-#include <fstream>
 #include <iostream>
 
 namespace lve {
+
+static std::string normalizePath(const std::string& filepath) {
+  return std::filesystem::path(filepath).lexically_normal().generic_string();
+}
 LvePipeline::LvePipeline(LveDevice& device, const std::string& vertFilepath,
                          const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
     : lveDevice{device} {
   createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+  for (const auto& filepath : {vertFilepath, fragFilepath}) {
+    shaderFilepaths.push_back(normalizePath(filepath));
+  }
+}
+
+LvePipeline::LvePipeline(LveDevice& device, const std::string& compFilepath,
+                         VkPipelineLayout pipelineLayout)
+    : lveDevice{device}, bindPoint{VK_PIPELINE_BIND_POINT_COMPUTE} {
+  createComputePipeline(compFilepath, pipelineLayout);
+  shaderFilepaths.push_back(normalizePath(compFilepath));
 }
 
 LvePipeline::~LvePipeline() {
   vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
   vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
-  vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
+  vkDestroyShaderModule(lveDevice.device(), compShaderModule, nullptr);
+  vkDestroyPipeline(lveDevice.device(), pipeline, nullptr);
 }
 
-std::vector<char> LvePipeline::readFile(const std::string& filepath) {
-  std::ifstream file{filepath, std::ios::ate | std::ios::binary};
+bool LvePipeline::usesShader(const std::string& filepath) const {
+  return std::find(shaderFilepaths.begin(), shaderFilepaths.end(), normalizePath(filepath)) !=
+         shaderFilepaths.end();
+}
 
-  if (!file.is_open()) {
+// SPIR-V is handed to the driver straight from the mapping, which is page aligned
+LveMappedFile LvePipeline::readFile(const std::string& filepath) {
+  LveMappedFile file{};
+  if (!file.open(filepath) || file.size() == 0) {
     throw std::runtime_error("failed to open file: " + filepath);
   }
-
-  auto fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> buffer(fileSize);
-
-  file.seekg(0);
-  file.read(buffer.data(), static_cast<uint32_t>(fileSize));
-
-  file.close();
-
-  return buffer;
+  return file;
 }
 
 void LvePipeline::createGraphicsPipeline(const std::string& vertFilepath,
@@ -101,12 +114,36 @@ void LvePipeline::createGraphicsPipeline(const std::string& vertFilepath,
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
   if (vkCreateGraphicsPipelines(lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-                                &graphicsPipeline) != VK_SUCCESS) {
+                                &pipeline) != VK_SUCCESS) {
     throw std::runtime_error("failed to create graphics pipeline");
   }
 }
 
-void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
+void LvePipeline::createComputePipeline(const std::string& compFilepath,
+                                        VkPipelineLayout pipelineLayout) {
+  assert(pipelineLayout != VK_NULL_HANDLE &&
+         "Cannot create compute pipeline: no pipelineLayout provided");
+
+  auto compCode = readFile(compFilepath);
+  createShaderModule(compCode, &compShaderModule);
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compShaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (vkCreateComputePipelines(lveDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
+                               &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline");
+  }
+}
+
+void LvePipeline::createShaderModule(const LveMappedFile& code, VkShaderModule* shaderModule) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize = code.size();
@@ -193,6 +230,6 @@ void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 }
 
 void LvePipeline::bind(VkCommandBuffer commandBuffer) {
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+  vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
 }
 } // namespace lve
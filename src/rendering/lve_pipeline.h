@@ -6,6 +6,8 @@
 #include <vector>
 
 namespace lve {
+class LveMappedFile;
+
 struct PipelineConfigInfo {
   PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 
@@ -32,6 +34,9 @@ public:
   LvePipeline(LveDevice& device, const std::string& vertFilepath, const std::string& fragFilepath,
               const PipelineConfigInfo& configInfo);
 
+  // compute pipeline
+  LvePipeline(LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
   LvePipeline() = delete;
 
   ~LvePipeline();
@@ -42,19 +47,28 @@ public:
 
   void bind(VkCommandBuffer commandBuffer);
 
+  // true if the pipeline was created from the SPIR-V file at filepath, for hot reloading
+  [[nodiscard]] bool usesShader(const std::string& filepath) const;
+
   static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
 private:
-  static std::vector<char> readFile(const std::string& filepath);
+  static LveMappedFile readFile(const std::string& filepath);
 
   void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath,
                               const PipelineConfigInfo& configInfo);
 
-  void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+  void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
+  void createShaderModule(const LveMappedFile& code, VkShaderModule* shaderModule);
 
   LveDevice& lveDevice;
-  VkPipeline graphicsPipeline{};
+  VkPipeline pipeline{};
+  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
   VkShaderModule vertShaderModule{};
   VkShaderModule fragShaderModule{};
+  VkShaderModule compShaderModule{};
+  // normalized paths of the SPIR-V files
+  std::vector<std::string> shaderFilepaths{};
 };
 } // namespace lve
@@ -0,0 +1,67 @@
+#include "lve_pipeline_reloader.h"
+#include "lve_deletion_queue.h"
+#include <cassert>
+#include <chrono>
+#include <fmt/core.h>
+
+namespace lve {
+
+LvePipelineReloader::LvePipelineReloader(LveDevice& device, LveThreadPool& threadPool)
+    : lveDevice{device}, threadPool{threadPool} {}
+
+LvePipelineReloader::~LvePipelineReloader() { wait(); }
+
+void LvePipelineReloader::reload(const std::string& filepath, std::function<Pipelines()> build) {
+  if (building.valid()) {
+    queuedBuild = std::move(build);
+    queuedFilepath = filepath;
+    return;
+  }
+  buildingFilepath = filepath;
+  start(std::move(build));
+}
+
+void LvePipelineReloader::start(std::function<Pipelines()> build) {
+  building = threadPool.submit(std::move(build));
+}
+
+bool LvePipelineReloader::swap(const std::vector<std::unique_ptr<LvePipeline>*>& targets) {
+  if (!building.valid() ||
+      building.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+    return false;
+  }
+
+  Pipelines pipelines{};
+  try {
+    pipelines = building.get();
+  } catch (const std::exception& e) {
+    fmt::println("failed to reload {}: {}", buildingFilepath, e.what());
+  }
+
+  if (queuedBuild) {
+    buildingFilepath = std::move(queuedFilepath);
+    start(std::move(queuedBuild));
+    queuedBuild = nullptr;
+  }
+
+  if (pipelines.empty()) {
+    return false;
+  }
+  assert(pipelines.size() == targets.size() && "Build has to return a pipeline per target");
+
+  auto retired = std::make_shared<Pipelines>();
+  for (size_t i = 0; i < targets.size(); i++) {
+    retired->push_back(std::move(*targets[i]));
+    *targets[i] = std::move(pipelines[i]);
+  }
+  lveDevice.deletionQueue().push([retired]() mutable { retired.reset(); });
+  return true;
+}
+
+void LvePipelineReloader::wait() {
+  if (building.valid()) {
+    building.wait();
+  }
+}
+
+} // namespace lve
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../lve_thread_pool.h"
+#include "lve_pipeline.h"
+
+// std
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Rebuilds the pipelines of a render system in the background after one of their shaders changed.
+ *
+ * reload() hands the build to the thread pool, creating shader modules and pipelines needs no
+ * externally synchronized Vulkan state. The render system calls swap() at a frame boundary, before
+ * it records anything, which replaces its pipelines once the build has finished. Replaced pipelines
+ * are destroyed through the deletion queue once no frame in flight uses them any more, and stay in
+ * use if the build failed.
+ *
+ * Call from the main thread only. The build may use state of the render system, call wait() before
+ * destroying any of it.
+ */
+class LvePipelineReloader {
+public:
+  using Pipelines = std::vector<std::unique_ptr<LvePipeline>>;
+
+  LvePipelineReloader(LveDevice& device, LveThreadPool& threadPool);
+  ~LvePipelineReloader();
+
+  LvePipelineReloader(const LvePipelineReloader&) = delete;
+  LvePipelineReloader& operator=(const LvePipelineReloader&) = delete;
+
+  // a reload requested while a build is running starts once that one was swapped in
+  void reload(const std::string& filepath, std::function<Pipelines()> build);
+
+  /**
+   * Moves the pipelines of a finished build into targets, in the order build returned them
+   *
+   * @return true if the pipelines were replaced
+   */
+  bool swap(const std::vector<std::unique_ptr<LvePipeline>*>& targets);
+
+  void wait();
+
+private:
+  void start(std::function<Pipelines()> build);
+
+  LveDevice& lveDevice;
+  LveThreadPool& threadPool;
+  std::future<Pipelines> building{};
+  std::string buildingFilepath{};
+  std::function<Pipelines()> queuedBuild{};
+  std::string queuedFilepath{};
+};
+
+} // namespace lve
@@ -20,7 +20,7 @@ void LveRenderer::recreateSwapchain() {
     glfwWaitEvents();
   }
 
-  vkDeviceWaitIdle(lveDevice.device());
+  lveDevice.waitIdle();
 
   if (lveSwapchain == nullptr) {
     lveSwapchain.reset(nullptr);
@@ -22,6 +22,10 @@ public:
 
   [[nodiscard]] float getAspectRatio() const { return lveSwapchain->extentAspectRatio(); }
 
+  [[nodiscard]] VkExtent2D getExtent() const {
+    return {lveSwapchain->width(), lveSwapchain->height()};
+  }
+
   [[nodiscard]] bool isFrameInProgress() const { return isFrameStarted; };
 
   [[nodiscard]] VkCommandBuffer getCurrentCommandBuffer() const {
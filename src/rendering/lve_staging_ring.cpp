@@ -0,0 +1,113 @@
+#include "lve_staging_ring.h"
+
+// std
+#include <cassert>
+
+namespace lve {
+
+LveStagingRing::LveStagingRing(LveDevice& device, VkDeviceSize size)
+    : lveDevice{device}, size{size} {
+  lveDevice.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         buffer, allocation);
+  assert(allocation.mapped != nullptr && "Staging ring memory must be host visible");
+}
+
+LveStagingRing::~LveStagingRing() {
+  waitIdle();
+  lveDevice.destroyBuffer(buffer, allocation);
+}
+
+/**
+ * Reserves staging space at the head of the ring, waiting for in-flight uploads to retire if the
+ * ring is full
+ *
+ * @param allocationSize Number of bytes to reserve, at most the ring size
+ * @param alignment Required alignment of the returned offset
+ * @param offset Receives the offset of the reserved space in the ring buffer
+ *
+ * @return false if the space is only taken up by staged data that hasn't been submitted yet. The
+ * caller has to submit its copies and retire them before trying again
+ */
+bool LveStagingRing::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                              VkDeviceSize& offset) {
+  assert(allocationSize <= size && "Staging allocation larger than the ring");
+
+  reclaim(false);
+  while (!tryAllocate(allocationSize, alignment, offset)) {
+    if (submissions.empty()) {
+      return false;
+    }
+    reclaim(true);
+  }
+  return true;
+}
+
+/**
+ * Hands every byte staged since the last call over to the submission identified by ticket
+ */
+void LveStagingRing::retire(UploadTicket ticket) {
+  if (pendingBytes == 0) {
+    return;
+  }
+  submissions.push_back({ticket, head, pendingBytes});
+  pendingBytes = 0;
+}
+
+void LveStagingRing::waitIdle() {
+  assert(pendingBytes == 0 && "Staged data was never submitted");
+  while (!submissions.empty()) {
+    reclaim(true);
+  }
+}
+
+bool LveStagingRing::tryAllocate(VkDeviceSize allocationSize, VkDeviceSize alignment,
+                                 VkDeviceSize& offset) {
+  if (used == 0) {
+    head = 0;
+    tail = 0;
+  }
+
+  VkDeviceSize alignedHead = (head + alignment - 1) / alignment * alignment;
+
+  if (used == 0 || head > tail) {
+    // free space is [head, size) followed by [0, tail)
+    if (alignedHead + allocationSize <= size) {
+      offset = alignedHead;
+    } else if (allocationSize <= tail) {
+      // skip the end of the ring, the wasted bytes retire with this allocation
+      pendingBytes += size - head;
+      used += size - head;
+      head = 0;
+      offset = 0;
+    } else {
+      return false;
+    }
+  } else {
+    // wrapped: free space is [head, tail)
+    if (alignedHead + allocationSize > tail) {
+      return false;
+    }
+    offset = alignedHead;
+  }
+
+  VkDeviceSize bytes = offset + allocationSize - head;
+  head = offset + allocationSize;
+  used += bytes;
+  pendingBytes += bytes;
+  return true;
+}
+
+void LveStagingRing::reclaim(bool waitForOldest) {
+  if (waitForOldest && !submissions.empty()) {
+    lveDevice.waitForUpload(submissions.front().ticket);
+  }
+
+  while (!submissions.empty() && lveDevice.isUploadComplete(submissions.front().ticket)) {
+    tail = submissions.front().end;
+    used -= submissions.front().bytes;
+    submissions.pop_front();
+  }
+}
+
+} // namespace lve
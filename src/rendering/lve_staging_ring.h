@@ -0,0 +1,64 @@
+#pragma once
+
+#include "lve_device.h"
+
+// std
+#include <deque>
+
+namespace lve {
+
+/*
+ * Persistently mapped host visible buffer that all uploads are staged through.
+ *
+ * Staging space is handed out at the head of the ring. Once the copies reading it have been
+ * submitted, retire() ties the space to the submission's upload ticket and it is handed back as
+ * soon as that ticket has completed.
+ *
+ * @note Staged but unsubmitted space belongs to whoever submits next, so uploads are recorded
+ * from one thread at a time (see LveUploadBatch)
+ */
+class LveStagingRing {
+public:
+  static constexpr VkDeviceSize DEFAULT_SIZE = 32ull * 1024 * 1024;
+
+  explicit LveStagingRing(LveDevice& device, VkDeviceSize size = DEFAULT_SIZE);
+  ~LveStagingRing();
+
+  LveStagingRing(const LveStagingRing&) = delete;
+  LveStagingRing& operator=(const LveStagingRing&) = delete;
+
+  bool allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& offset);
+  void retire(UploadTicket ticket);
+  void waitIdle();
+
+  [[nodiscard]] VkBuffer getBuffer() const { return buffer; }
+  [[nodiscard]] VkDeviceSize getSize() const { return size; }
+  [[nodiscard]] void* getMappedData(VkDeviceSize offset) const {
+    return static_cast<char*>(allocation.mapped) + offset;
+  }
+
+private:
+  struct Submission {
+    UploadTicket ticket;
+    VkDeviceSize end;
+    VkDeviceSize bytes;
+  };
+
+  bool tryAllocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& offset);
+  void reclaim(bool waitForOldest);
+
+  LveDevice& lveDevice;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  LveAllocation allocation{};
+  VkDeviceSize size;
+
+  // bytes [tail, head) are in use, wrapping around the end of the ring
+  VkDeviceSize head = 0;
+  VkDeviceSize tail = 0;
+  VkDeviceSize used = 0;
+  VkDeviceSize pendingBytes = 0;
+
+  std::deque<Submission> submissions{};
+};
+
+} // namespace lve
@@ -44,8 +44,7 @@ LveSwapchain::~LveSwapchain() {
 
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-    vkDestroyImage(device.device(), depthImages[i], nullptr);
-    vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+    device.destroyImage(depthImages[i], depthImageAllocations[i]);
   }
 
   for (auto framebuffer : swapChainFramebuffers) {
@@ -99,6 +98,8 @@ VkResult LveSwapchain::submitCommandBuffers(const VkCommandBuffer* buffers,
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+  // upload threads submit to the graphics queue as well
+  std::lock_guard<std::mutex> lock{device.queueMutex()};
   if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
       VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
@@ -295,7 +296,7 @@ void LveSwapchain::createDepthResources() {
   VkExtent2D swapChainExtent = getSwapchainExtent();
 
   depthImages.resize(imageCount());
-  depthImageMemorys.resize(imageCount());
+  depthImageAllocations.resize(imageCount());
   depthImageViews.resize(imageCount());
 
   for (int i = 0; i < depthImages.size(); i++) {
@@ -316,7 +317,7 @@ void LveSwapchain::createDepthResources() {
     imageInfo.flags = 0;
 
     device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i],
-                               depthImageMemorys[i]);
+                               depthImageAllocations[i]);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -0,0 +1,308 @@
+#include "lve_upload_batch.h"
+#include "lve_staging_ring.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+// satisfies the offset alignment of vkCmdCopyBuffer and of every color format with a power of two
+// texel size in vkCmdCopyBufferToImage
+constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+LveUploadBatch::LveUploadBatch(LveDevice& device)
+    : lveDevice{device}, ticket_{std::make_shared<UploadTicket>(
+                             UploadTicket{UploadTicket::UNSUBMITTED})} {}
+
+LveUploadBatch::~LveUploadBatch() {
+  // staged data can't be left behind in the ring, nor images on the transfer queue
+  if (!empty() || !imageLayouts.empty()) {
+    submit();
+  }
+}
+
+void LveUploadBatch::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data,
+                                  VkDeviceSize size) {
+  // large uploads are split so they never need more than half the ring at once
+  VkDeviceSize maxChunk = lveDevice.stagingRing().getSize() / 2;
+  auto bytes = static_cast<const char*>(data);
+
+  for (VkDeviceSize copied = 0; copied < size;) {
+    VkDeviceSize chunk = std::min(size - copied, maxChunk);
+    VkDeviceSize offset = stage(bytes + copied, chunk, STAGING_ALIGNMENT);
+    copyBuffer(lveDevice.stagingRing().getBuffer(), dstBuffer,
+               {offset, dstOffset + copied, chunk});
+    copied += chunk;
+  }
+}
+
+/**
+ * Uploads elementCount elements of elementSize bytes that write produces directly in the staging
+ * ring, saving the copy out of a temporary array for data that has to be converted anyway
+ *
+ * @note write may be called several times for consecutive ranges, large uploads are split the same
+ * way uploadBuffer() splits them
+ */
+void LveUploadBatch::uploadElements(VkBuffer dstBuffer, VkDeviceSize dstOffset,
+                                    VkDeviceSize elementSize, uint32_t elementCount,
+                                    const ElementWriter& write) {
+  auto& ring = lveDevice.stagingRing();
+  VkDeviceSize maxChunk = std::max<VkDeviceSize>(ring.getSize() / 2 / elementSize, 1);
+
+  for (uint32_t first = 0; first < elementCount;) {
+    auto count = static_cast<uint32_t>(std::min<VkDeviceSize>(elementCount - first, maxChunk));
+    VkDeviceSize size = count * elementSize;
+    VkDeviceSize offset = reserve(size, STAGING_ALIGNMENT);
+    write(ring.getMappedData(offset), first, count);
+    copyBuffer(ring.getBuffer(), dstBuffer, {offset, dstOffset + first * elementSize, size});
+    first += count;
+  }
+}
+
+/**
+ * Stages a tightly packed image region and records its copy
+ *
+ * @note Images are moved out of an undefined layout before their first copy and are released to
+ * the graphics queue by submit(), so all regions of an image have to be recorded into the same
+ * batch
+ */
+void LveUploadBatch::uploadImage(VkImage dstImage, const VkBufferImageCopy& region,
+                                 const void* data, VkDeviceSize size) {
+  if (size > lveDevice.stagingRing().getSize()) {
+    throw std::runtime_error("image region does not fit into the staging ring!");
+  }
+
+  VkBufferImageCopy staged = region;
+  staged.bufferOffset = stage(data, size, STAGING_ALIGNMENT);
+  staged.bufferRowLength = 0;
+  staged.bufferImageHeight = 0;
+  copyBufferToImage(lveDevice.stagingRing().getBuffer(), dstImage, staged, size);
+}
+
+void LveUploadBatch::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                                const VkBufferCopy& region) {
+  bufferCopies.push_back({srcBuffer, dstBuffer, region});
+}
+
+/**
+ * Records a buffer to image copy
+ *
+ * @param regionSize Size of the region's data if it is tightly packed, allows merging it with
+ * the rows directly below it
+ */
+void LveUploadBatch::copyBufferToImage(VkBuffer srcBuffer, VkImage dstImage,
+                                       const VkBufferImageCopy& region, VkDeviceSize regionSize) {
+  imageCopies.push_back({srcBuffer, dstImage, region, regionSize});
+}
+
+/**
+ * Records all collected copies into one command buffer and submits it on the transfer queue
+ *
+ * @return Ticket that completes once every copy recorded into this batch has landed. The batch
+ * can be reused afterwards, it starts over with a fresh ticket
+ */
+UploadTicket LveUploadBatch::submit() {
+  // tickets complete in order, so the last submission covers the early ones as well. Images
+  // written early still have to be released even if nothing was recorded since
+  if (!empty() || !imageLayouts.empty()) {
+    submittedValue = flush(true).value;
+  }
+  ticket_->value = submittedValue;
+
+  UploadTicket ticket = *ticket_;
+  ticket_ = std::make_shared<UploadTicket>(UploadTicket{UploadTicket::UNSUBMITTED});
+  submittedValue = 0;
+  return ticket;
+}
+
+VkDeviceSize LveUploadBatch::reserve(VkDeviceSize size, VkDeviceSize alignment) {
+  auto& ring = lveDevice.stagingRing();
+
+  VkDeviceSize offset;
+  if (!ring.allocate(size, alignment, offset)) {
+    // the ring is full of our own copies, send them off so their space can be reclaimed
+    submittedValue = flush(false).value;
+    if (!ring.allocate(size, alignment, offset)) {
+      throw std::runtime_error("failed to allocate staging memory!");
+    }
+  }
+
+  return offset;
+}
+
+VkDeviceSize LveUploadBatch::stage(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+  VkDeviceSize offset = reserve(size, alignment);
+  std::memcpy(lveDevice.stagingRing().getMappedData(offset), data, size);
+  return offset;
+}
+
+/**
+ * Submits the recorded copies
+ *
+ * @param last Whether this is the batch's final submission, which releases every image written
+ * since the last submit() to the graphics queue. Earlier ones keep the images in
+ * TRANSFER_DST_OPTIMAL on the transfer queue
+ */
+UploadTicket LveUploadBatch::flush(bool last) {
+  mergeBufferCopies();
+  mergeImageCopies();
+
+  std::vector<VkBuffer> dstBuffers{};
+  std::vector<VkImage> dstImages{};
+  for (auto& copy : bufferCopies) {
+    if (dstBuffers.empty() || dstBuffers.back() != copy.dst) {
+      dstBuffers.push_back(copy.dst);
+    }
+  }
+  for (auto& copy : imageCopies) {
+    if (dstImages.empty() || dstImages.back() != copy.dst) {
+      dstImages.push_back(copy.dst);
+    }
+  }
+
+  // images written by an earlier submission keep their data, only new ones start undefined
+  std::vector<VkImageLayout> oldLayouts(dstImages.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+  for (size_t i = 0; i < dstImages.size(); i++) {
+    auto layout = imageLayouts.find(dstImages[i]);
+    if (layout != imageLayouts.end()) {
+      oldLayouts[i] = layout->second;
+    }
+    imageLayouts[dstImages[i]] = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  }
+
+  auto record = [&](VkCommandBuffer commandBuffer) {
+    if (!dstImages.empty()) {
+      std::vector<VkImageMemoryBarrier> barriers(dstImages.size());
+      for (size_t i = 0; i < dstImages.size(); i++) {
+        bool written = oldLayouts[i] != VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = written ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+        barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[i].oldLayout = oldLayouts[i];
+        barriers[i].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image = dstImages[i];
+        barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barriers[i].subresourceRange.baseMipLevel = 0;
+        barriers[i].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barriers[i].subresourceRange.baseArrayLayer = 0;
+        barriers[i].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+      }
+      vkCmdPipelineBarrier(commandBuffer,
+                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                           static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+
+    // one command per source/destination pair, copies are sorted so each pair is contiguous
+    std::vector<VkBufferCopy> regions{};
+    for (size_t i = 0; i < bufferCopies.size(); i++) {
+      regions.push_back(bufferCopies[i].region);
+      if (i + 1 == bufferCopies.size() || bufferCopies[i + 1].src != bufferCopies[i].src ||
+          bufferCopies[i + 1].dst != bufferCopies[i].dst) {
+        vkCmdCopyBuffer(commandBuffer, bufferCopies[i].src, bufferCopies[i].dst,
+                        static_cast<uint32_t>(regions.size()), regions.data());
+        regions.clear();
+      }
+    }
+
+    std::vector<VkBufferImageCopy> imageRegions{};
+    for (size_t i = 0; i < imageCopies.size(); i++) {
+      imageRegions.push_back(imageCopies[i].region);
+      if (i + 1 == imageCopies.size() || imageCopies[i + 1].src != imageCopies[i].src ||
+          imageCopies[i + 1].dst != imageCopies[i].dst) {
+        vkCmdCopyBufferToImage(commandBuffer, imageCopies[i].src, imageCopies[i].dst,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+        imageRegions.clear();
+      }
+    }
+  };
+
+  std::vector<VkImage> releasedImages{};
+  if (last) {
+    for (const auto& [image, layout] : imageLayouts) {
+      releasedImages.push_back(image);
+    }
+    imageLayouts.clear();
+  }
+
+  UploadTicket ticket = lveDevice.submitUploadCommands(record, dstBuffers, releasedImages);
+  lveDevice.stagingRing().retire(ticket);
+
+  bufferCopies.clear();
+  imageCopies.clear();
+  return ticket;
+}
+
+void LveUploadBatch::mergeBufferCopies() {
+  std::stable_sort(bufferCopies.begin(), bufferCopies.end(),
+                   [](const BufferCopy& a, const BufferCopy& b) {
+                     if (a.dst != b.dst) {
+                       return a.dst < b.dst;
+                     }
+                     if (a.src != b.src) {
+                       return a.src < b.src;
+                     }
+                     return a.region.dstOffset < b.region.dstOffset;
+                   });
+
+  std::vector<BufferCopy> merged{};
+  for (auto& copy : bufferCopies) {
+    if (!merged.empty()) {
+      auto& last = merged.back();
+      if (last.src == copy.src && last.dst == copy.dst &&
+          last.region.srcOffset + last.region.size == copy.region.srcOffset &&
+          last.region.dstOffset + last.region.size == copy.region.dstOffset) {
+        last.region.size += copy.region.size;
+        continue;
+      }
+    }
+    merged.push_back(copy);
+  }
+  bufferCopies = std::move(merged);
+}
+
+void LveUploadBatch::mergeImageCopies() {
+  std::stable_sort(imageCopies.begin(), imageCopies.end(),
+                   [](const ImageCopy& a, const ImageCopy& b) {
+                     if (a.dst != b.dst) {
+                       return a.dst < b.dst;
+                     }
+                     return a.src < b.src;
+                   });
+
+  // tightly packed regions directly below each other whose data follows each other in the
+  // source buffer are the same copy as one taller region
+  auto continues = [](const ImageCopy& a, const ImageCopy& b) {
+    const auto& ra = a.region;
+    const auto& rb = b.region;
+    return a.src == b.src && a.dst == b.dst && a.size != 0 && b.size != 0 &&
+           ra.bufferRowLength == 0 && rb.bufferRowLength == 0 && ra.bufferImageHeight == 0 &&
+           rb.bufferImageHeight == 0 && ra.imageExtent.depth == 1 && rb.imageExtent.depth == 1 &&
+           ra.imageSubresource.aspectMask == rb.imageSubresource.aspectMask &&
+           ra.imageSubresource.mipLevel == rb.imageSubresource.mipLevel &&
+           ra.imageSubresource.baseArrayLayer == rb.imageSubresource.baseArrayLayer &&
+           ra.imageSubresource.layerCount == 1 && rb.imageSubresource.layerCount == 1 &&
+           ra.imageOffset.x == rb.imageOffset.x && ra.imageOffset.z == rb.imageOffset.z &&
+           ra.imageExtent.width == rb.imageExtent.width &&
+           ra.imageOffset.y + static_cast<int32_t>(ra.imageExtent.height) == rb.imageOffset.y &&
+           ra.bufferOffset + a.size == rb.bufferOffset;
+  };
+
+  std::vector<ImageCopy> merged{};
+  for (auto& copy : imageCopies) {
+    if (!merged.empty() && continues(merged.back(), copy)) {
+      merged.back().region.imageExtent.height += copy.region.imageExtent.height;
+      merged.back().size += copy.size;
+      continue;
+    }
+    merged.push_back(copy);
+  }
+  imageCopies = std::move(merged);
+}
+
+} // namespace lve
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "lve_device.h"
+
+// std
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+/*
+ * Collects buffer and image copies and hands them to the transfer queue in a single submission.
+ *
+ * Data passed to uploadBuffer()/uploadImage() is staged through the device's staging ring right
+ * away, uploadElements() lets the caller write it into the ring itself instead of copying it from
+ * a temporary. The copies themselves are only recorded on submit(). Adjacent regions targeting
+ * the same resource are merged into one region before recording.
+ *
+ * Everything recorded into a batch shares the ticket returned by ticket(), which stays
+ * UNSUBMITTED until the batch has been submitted. Should the staging ring fill up before that,
+ * the recorded copies are submitted early. The ticket is only set by submit(), to the last
+ * submission, so it covers all of them. Images written by early submissions stay with the
+ * transfer queue in TRANSFER_DST_OPTIMAL until submit() releases them.
+ */
+class LveUploadBatch {
+public:
+  explicit LveUploadBatch(LveDevice& device);
+  ~LveUploadBatch();
+
+  LveUploadBatch(const LveUploadBatch&) = delete;
+  LveUploadBatch& operator=(const LveUploadBatch&) = delete;
+
+  // writes elements [first, first + count) to dst, which points into the staging ring
+  using ElementWriter = std::function<void(void* dst, uint32_t first, uint32_t count)>;
+
+  void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data,
+                    VkDeviceSize size);
+  void uploadElements(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize elementSize,
+                      uint32_t elementCount, const ElementWriter& write);
+  // data has to be tightly packed, bufferOffset, bufferRowLength and bufferImageHeight of the
+  // region are ignored
+  void uploadImage(VkImage dstImage, const VkBufferImageCopy& region, const void* data,
+                   VkDeviceSize size);
+
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& region);
+  void copyBufferToImage(VkBuffer srcBuffer, VkImage dstImage, const VkBufferImageCopy& region,
+                         VkDeviceSize regionSize = 0);
+
+  UploadTicket submit();
+
+  [[nodiscard]] bool empty() const { return bufferCopies.empty() && imageCopies.empty(); }
+  [[nodiscard]] std::shared_ptr<const UploadTicket> ticket() const { return ticket_; }
+
+private:
+  struct BufferCopy {
+    VkBuffer src;
+    VkBuffer dst;
+    VkBufferCopy region;
+  };
+
+  struct ImageCopy {
+    VkBuffer src;
+    VkImage dst;
+    VkBufferImageCopy region;
+    // bytes covered by the region if it is tightly packed, 0 if unknown
+    VkDeviceSize size;
+  };
+
+  VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment);
+  VkDeviceSize stage(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+  UploadTicket flush(bool last);
+  void mergeBufferCopies();
+  void mergeImageCopies();
+
+  LveDevice& lveDevice;
+  std::vector<BufferCopy> bufferCopies{};
+  std::vector<ImageCopy> imageCopies{};
+  // layout of every image written since the last submit(), left by an earlier submission
+  std::unordered_map<VkImage, VkImageLayout> imageLayouts{};
+  // value of the latest early submission, 0 if there was none
+  uint64_t submittedValue = 0;
+  std::shared_ptr<UploadTicket> ticket_;
+};
+
+} // namespace lve
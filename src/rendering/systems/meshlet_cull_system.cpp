@@ -0,0 +1,259 @@
+#include "meshlet_cull_system.h"
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include "glm/glm.hpp"
+
+namespace lve {
+struct MeshletCullPushConstants {
+  glm::mat4 modelView{1.f};
+  // xy and zw are the normalized x and y side planes of a perspective frustum
+  glm::vec4 frustum{0.f};
+  float nearPlane = 0.f;
+  // largest axis scale of modelView, applied to radii
+  float scale = 1.f;
+  uint32_t firstMeshlet = 0;
+  uint32_t meshletCount = 0;
+  uint32_t firstDraw = 0;
+  uint32_t firstIndex = 0;
+  int32_t vertexOffset = 0;
+  // CULL_FLAG_*, shared with meshlet_cull.comp
+  uint32_t flags = 0;
+  uint32_t countIndex = 0;
+};
+
+constexpr uint32_t CULL_FLAG_PERSPECTIVE = 1;
+// modelView scales uniformly, so it transforms normal cone axes like the normal matrix would
+constexpr uint32_t CULL_FLAG_CONE = 2;
+// visible draws are appended through the count at countIndex instead of keeping their slot
+constexpr uint32_t CULL_FLAG_COMPACT = 4;
+
+static_assert(sizeof(MeshletCullPushConstants) <= 128,
+              "push constants beyond the guaranteed minimum size");
+
+constexpr uint32_t LOCAL_SIZE = 64;
+
+MeshletCullSystem::MeshletCullSystem(LveDevice& device, LveThreadPool& threadPool)
+    : lveDevice{device}, pipelineReloader{device, threadPool} {
+  createDrawBuffers();
+  createDescriptorSets();
+  createPipelineLayout();
+  lvePipeline = createPipeline();
+}
+
+MeshletCullSystem::~MeshletCullSystem() {
+  // a reload may still be building with the layout
+  pipelineReloader.wait();
+  vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
+  for (size_t i = 0; i < drawBuffers.size(); i++) {
+    lveDevice.destroyBuffer(drawBuffers[i], drawAllocations[i]);
+    lveDevice.destroyBuffer(countBuffers[i], countAllocations[i]);
+  }
+}
+
+void MeshletCullSystem::createDrawBuffers() {
+  for (size_t i = 0; i < drawBuffers.size(); i++) {
+    lveDevice.createBuffer(MAX_DRAWS_PER_FRAME * sizeof(VkDrawIndexedIndirectCommand),
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBuffers[i], drawAllocations[i]);
+    lveDevice.createBuffer(MAX_DRAWS_PER_FRAME * sizeof(uint32_t),
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBuffers[i],
+                           countAllocations[i]);
+  }
+}
+
+void MeshletCullSystem::createDescriptorSets() {
+  setLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+  descriptorPool =
+      LveDescriptorPool::Builder(lveDevice)
+          .setMaxSets(LveSwapchain::MAX_FRAMES_IN_FLIGHT)
+          .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapchain::MAX_FRAMES_IN_FLIGHT)
+          .build();
+
+  VkDescriptorBufferInfo meshletInfo{lveDevice.geometryArena().getMeshletBuffer(), 0,
+                                     VK_WHOLE_SIZE};
+  for (size_t i = 0; i < descriptorSets.size(); i++) {
+    VkDescriptorBufferInfo drawInfo{drawBuffers[i], 0, VK_WHOLE_SIZE};
+    VkDescriptorBufferInfo countInfo{countBuffers[i], 0, VK_WHOLE_SIZE};
+    if (!LveDescriptorWriter(*setLayout, *descriptorPool)
+             .writeBuffer(0, &meshletInfo)
+             .writeBuffer(1, &drawInfo)
+             .writeBuffer(2, &countInfo)
+             .build(descriptorSets[i])) {
+      throw std::runtime_error("failed to allocate meshlet cull descriptor set!");
+    }
+  }
+}
+
+void MeshletCullSystem::createPipelineLayout() {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MeshletCullPushConstants);
+
+  VkDescriptorSetLayout descriptorSetLayout = setLayout->getDescriptorSetLayout();
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(lveDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+}
+
+// runs on worker threads for reloads
+std::unique_ptr<LvePipeline> MeshletCullSystem::createPipeline() const {
+  assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
+
+  return std::make_unique<LvePipeline>(lveDevice, "./shaders/meshlet_cull.comp.spv",
+                                       pipelineLayout);
+}
+
+void MeshletCullSystem::reloadShader(const std::string& filepath) {
+  if (!lvePipeline->usesShader(filepath)) {
+    return;
+  }
+
+  pipelineReloader.reload(filepath, [this]() {
+    LvePipelineReloader::Pipelines pipelines{};
+    pipelines.push_back(createPipeline());
+    return pipelines;
+  });
+}
+
+void MeshletCullSystem::begin() {
+  pipelineReloader.swap({&lvePipeline});
+  drawCount = 0;
+  cullCount = 0;
+  pipelineBound = false;
+}
+
+bool MeshletCullSystem::cull(FrameInfo& frameInfo, const LveModel& model,
+                             const LveModel::Submesh& submesh, const glm::mat4& modelMatrix,
+                             DrawRange& range) {
+  // one draw call per meshlet would cost more than culling saves
+  if (!lveDevice.hasMultiDrawIndirect() || !model.hasMeshlets() || submesh.meshletCount == 0 ||
+      drawCount + submesh.meshletCount > MAX_DRAWS_PER_FRAME) {
+    return false;
+  }
+
+  // the pipeline is only bound once something is culled, frames without meshlets skip it
+  bool compact = lveDevice.hasDrawIndirectCount();
+  if (!pipelineBound) {
+    if (compact) {
+      VkBuffer countBuffer = countBuffers[frameInfo.frameIndex];
+      vkCmdFillBuffer(frameInfo.commandBuffer, countBuffer, 0, VK_WHOLE_SIZE, 0);
+
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      vkCmdPipelineBarrier(frameInfo.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                           nullptr);
+    }
+
+    lvePipeline->bind(frameInfo.commandBuffer);
+    vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout, 0, 1, &descriptorSets[frameInfo.frameIndex], 0,
+                            nullptr);
+    pipelineBound = true;
+  }
+
+  MeshletCullPushConstants push{};
+  push.modelView = frameInfo.camera.getView() * modelMatrix;
+  glm::vec3 axisScales{glm::length(glm::vec3(push.modelView[0])),
+                       glm::length(glm::vec3(push.modelView[1])),
+                       glm::length(glm::vec3(push.modelView[2]))};
+  push.scale = glm::max(axisScales.x, glm::max(axisScales.y, axisScales.z));
+  // non-uniform scale bends normals away from mat3(modelView) * axis, so the cone can't be trusted
+  float minScale = glm::min(axisScales.x, glm::min(axisScales.y, axisScales.z));
+  if (push.scale - minScale <= 1e-3f * push.scale) {
+    push.flags |= CULL_FLAG_CONE;
+  }
+
+  // the view looks down +z, a point is inside the side planes while |P00 * x| <= z
+  const glm::mat4& projection = frameInfo.camera.getProjection();
+  if (projection[2][3] != 0.f) {
+    float x = std::abs(projection[0][0]);
+    float y = std::abs(projection[1][1]);
+    push.frustum = glm::vec4(x, 1.f, y, 1.f);
+    push.frustum.x /= std::sqrt(x * x + 1.f);
+    push.frustum.y /= std::sqrt(x * x + 1.f);
+    push.frustum.z /= std::sqrt(y * y + 1.f);
+    push.frustum.w /= std::sqrt(y * y + 1.f);
+    push.nearPlane = -projection[3][2] / projection[2][2];
+    push.flags |= CULL_FLAG_PERSPECTIVE;
+  }
+
+  push.firstMeshlet = model.getFirstMeshlet() + submesh.firstMeshlet;
+  push.meshletCount = submesh.meshletCount;
+  push.firstDraw = drawCount;
+  push.firstIndex = model.getFirstIndex() + submesh.firstIndex;
+  push.vertexOffset = model.getVertexOffset() + submesh.vertexOffset;
+  if (compact) {
+    push.flags |= CULL_FLAG_COMPACT;
+    push.countIndex = cullCount;
+  }
+
+  vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(MeshletCullPushConstants), &push);
+  vkCmdDispatch(frameInfo.commandBuffer, (submesh.meshletCount + LOCAL_SIZE - 1) / LOCAL_SIZE, 1,
+                1);
+
+  range.firstDraw = drawCount;
+  range.maxDrawCount = submesh.meshletCount;
+  range.countIndex = cullCount;
+  drawCount += submesh.meshletCount;
+  cullCount++;
+  return true;
+}
+
+void MeshletCullSystem::end(FrameInfo& frameInfo) {
+  if (drawCount == 0) {
+    return;
+  }
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(frameInfo.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                       nullptr);
+}
+
+void MeshletCullSystem::draw(FrameInfo& frameInfo, const DrawRange& range) const {
+  VkBuffer drawBuffer = drawBuffers[frameInfo.frameIndex];
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  if (lveDevice.hasDrawIndirectCount()) {
+    lveDevice.cmdDrawIndexedIndirectCount(frameInfo.commandBuffer, drawBuffer,
+                                          VkDeviceSize{range.firstDraw} * stride,
+                                          countBuffers[frameInfo.frameIndex],
+                                          VkDeviceSize{range.countIndex} * sizeof(uint32_t),
+                                          range.maxDrawCount, stride);
+    return;
+  }
+
+  // culled slots have no instances, cull only succeeds with multiDrawIndirect
+  vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, drawBuffer,
+                           VkDeviceSize{range.firstDraw} * stride, range.maxDrawCount, stride);
+}
+} // namespace lve
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../../lve_model.h"
+#include "../lve_descriptors.h"
+#include "../lve_frame_info.h"
+#include "../lve_pipeline.h"
+#include "../lve_pipeline_reloader.h"
+#include "../lve_swapchain.h"
+#include <array>
+#include <memory>
+
+namespace lve {
+/*
+ * Culls the meshlets of submeshes on the GPU before they are drawn.
+ *
+ * A compute pass tests every meshlet's bounding sphere against the view frustum and its normal
+ * cone against the view direction, then writes one VkDrawIndexedIndirectCommand per visible meshlet
+ * into the frame's draw buffer. With VK_KHR_draw_indirect_count the visible draws are compacted
+ * through an atomic counter per submesh, which the draw reads its count from. Without it culled
+ * meshlets keep their slot with an instanceCount of 0, and without multiDrawIndirect, where every
+ * slot would cost a draw call of its own, nothing is culled and submeshes are drawn directly.
+ *
+ * Record begin, cull for every submesh and end outside of a render pass, then draw the returned
+ * ranges inside of it.
+ */
+class MeshletCullSystem {
+public:
+  static constexpr uint32_t MAX_DRAWS_PER_FRAME = 16 * 1024;
+
+  // the draws of one culled submesh
+  struct DrawRange {
+    uint32_t firstDraw = 0;
+    uint32_t maxDrawCount = 0;
+    // slot of the submesh's draw count in the frame's count buffer, if draws are compacted
+    uint32_t countIndex = 0;
+  };
+
+  MeshletCullSystem(LveDevice& device, LveThreadPool& threadPool);
+
+  ~MeshletCullSystem();
+
+  MeshletCullSystem(const MeshletCullSystem&) = delete;
+  MeshletCullSystem& operator=(const MeshletCullSystem&) = delete;
+
+  // swaps in a pipeline reloaded since the last frame
+  void begin();
+
+  /**
+   * Records the culling dispatch of one submesh, modelMatrix has to include the submesh transform
+   *
+   * @return false if the model has no meshlets, the device lacks multiDrawIndirect or the frame's
+   * draw buffer is full, the submesh has to be drawn directly then
+   */
+  bool cull(FrameInfo& frameInfo, const LveModel& model, const LveModel::Submesh& submesh,
+            const glm::mat4& modelMatrix, DrawRange& range);
+
+  // makes the written draws visible to indirect draws
+  void end(FrameInfo& frameInfo);
+
+  // the model has to be bound
+  void draw(FrameInfo& frameInfo, const DrawRange& range) const;
+
+  // rebuilds the pipeline in the background if it was created from the SPIR-V file at filepath
+  void reloadShader(const std::string& filepath);
+
+private:
+  void createDrawBuffers();
+
+  void createDescriptorSets();
+
+  void createPipelineLayout();
+
+  std::unique_ptr<LvePipeline> createPipeline() const;
+
+  LveDevice& lveDevice;
+
+  std::array<VkBuffer, LveSwapchain::MAX_FRAMES_IN_FLIGHT> drawBuffers{};
+  std::array<LveAllocation, LveSwapchain::MAX_FRAMES_IN_FLIGHT> drawAllocations{};
+  // one draw count per culled submesh, only written if draws are compacted
+  std::array<VkBuffer, LveSwapchain::MAX_FRAMES_IN_FLIGHT> countBuffers{};
+  std::array<LveAllocation, LveSwapchain::MAX_FRAMES_IN_FLIGHT> countAllocations{};
+
+  std::unique_ptr<LveDescriptorSetLayout> setLayout;
+  std::unique_ptr<LveDescriptorPool> descriptorPool;
+  std::array<VkDescriptorSet, LveSwapchain::MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+  std::unique_ptr<LvePipeline> lvePipeline;
+  VkPipelineLayout pipelineLayout;
+  LvePipelineReloader pipelineReloader;
+
+  uint32_t drawCount = 0;
+  uint32_t cullCount = 0;
+  bool pipelineBound = false;
+};
+} // namespace lve
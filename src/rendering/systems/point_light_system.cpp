@@ -15,14 +15,16 @@ struct PointLightPushConstants {
   float radius;
 };
 
-PointLightSystem::PointLightSystem(LveDevice& device, VkRenderPass renderPass,
-                                   VkDescriptorSetLayout globalSetLayout)
-    : lveDevice{device} {
+PointLightSystem::PointLightSystem(LveDevice& device, LveThreadPool& threadPool,
+                                   VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+    : lveDevice{device}, pipelineReloader{device, threadPool} {
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  lvePipeline = createPipeline(renderPass);
 }
 
 PointLightSystem::~PointLightSystem() {
+  // a reload may still be building with the layout
+  pipelineReloader.wait();
   vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -46,7 +48,8 @@ void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayou
   }
 }
 
-void PointLightSystem::createPipeline(VkRenderPass renderPass) {
+// runs on worker threads for reloads
+std::unique_ptr<LvePipeline> PointLightSystem::createPipeline(VkRenderPass renderPass) const {
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
@@ -58,28 +61,43 @@ void PointLightSystem::createPipeline(VkRenderPass renderPass) {
 
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(lveDevice, "./shaders/point_light.vert.spv",
-                                              "./shaders/point_light.frag.spv", pipelineConfig);
+  return std::make_unique<LvePipeline>(lveDevice, "./shaders/point_light.vert.spv",
+                                       "./shaders/point_light.frag.spv", pipelineConfig);
 }
 
-void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
+void PointLightSystem::reloadShader(const std::string& filepath, VkRenderPass renderPass) {
+  if (!lvePipeline->usesShader(filepath)) {
+    return;
+  }
+
+  pipelineReloader.reload(filepath, [this, renderPass]() {
+    LvePipelineReloader::Pipelines pipelines{};
+    pipelines.push_back(createPipeline(renderPass));
+    return pipelines;
+  });
+}
+
+void PointLightSystem::update(FrameInfo& frameInfo) {
+  pipelineReloader.swap({&lvePipeline});
   auto rotateLight = glm::rotate(glm::mat4(1.f), frameInfo.frameTime, {0.f, -1.f, 0.f});
-  int lightIndex = 0;
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.pointLightComponent == nullptr) {
-      continue;
-    }
+  auto& scene = frameInfo.scene;
+  for (uint32_t id : scene.pointLights.ids()) {
+    auto& transform = scene.editTransform(id);
+    transform.translation = glm::vec3(rotateLight * glm::vec4(transform.translation, 1.f));
+  }
+}
 
+void PointLightSystem::writeLights(FrameInfo& frameInfo, GlobalUbo& ubo) {
+  int lightIndex = 0;
+  const auto& scene = frameInfo.scene;
+  const auto& lights = scene.pointLights.components();
+  const auto& ids = scene.pointLights.ids();
+  for (size_t i = 0; i < lights.size(); i++) {
     assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
 
-    // update light position
-    obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
-
     // copy light to ubo
-    ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
-    ubo.pointLights[lightIndex].color =
-        glm::vec4(obj.color, obj.pointLightComponent->lightIntensity);
+    ubo.pointLights[lightIndex].position = scene.transforms().get(ids[i]).worldMatrix[3];
+    ubo.pointLights[lightIndex].color = glm::vec4(lights[i].color, lights[i].lightIntensity);
 
     lightIndex += 1;
   }
@@ -91,18 +109,19 @@ void PointLightSystem::render(FrameInfo& frameInfo) {
   lvePipeline->bind(frameInfo.commandBuffer);
 
   vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-                          0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+                          0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
 
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.pointLightComponent == nullptr) {
-      continue;
-    }
+  const auto& scene = frameInfo.scene;
+  const auto& lights = scene.pointLights.components();
+  const auto& ids = scene.pointLights.ids();
+  for (size_t i = 0; i < lights.size(); i++) {
+    const auto& transform = scene.transforms().get(ids[i]);
 
     PointLightPushConstants push{};
-    push.position = glm::vec4(obj.transform.translation, 1.f);
-    push.color = glm::vec4(obj.color, obj.pointLightComponent->lightIntensity);
-    push.radius = obj.transform.scale.x;
+    push.position = transform.worldMatrix[3];
+    push.color = glm::vec4(lights[i].color, lights[i].lightIntensity);
+    // scale.x holds the radius, parents scale it as well
+    push.radius = glm::length(glm::vec3(transform.worldMatrix[0]));
 
     vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
                        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
@@ -5,6 +5,7 @@
 #include "../../lve_model.h"
 #include "../lve_frame_info.h"
 #include "../lve_pipeline.h"
+#include "../lve_pipeline_reloader.h"
 #include "../lve_renderer.h"
 #include "../lve_window.h"
 #include <memory>
@@ -13,7 +14,7 @@ namespace lve {
 
 class PointLightSystem {
 public:
-  PointLightSystem(LveDevice& device, VkRenderPass renderPass,
+  PointLightSystem(LveDevice& device, LveThreadPool& threadPool, VkRenderPass renderPass,
                    VkDescriptorSetLayout globalSetLayout);
 
   ~PointLightSystem();
@@ -21,17 +22,24 @@ public:
   PointLightSystem(const PointLightSystem&) = delete;
   PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-  void update(FrameInfo& frameInfo, GlobalUbo& ubo);
+  // moves the lights, their transforms have to be updated before writeLights. Swaps in a pipeline
+  // reloaded since the last frame
+  void update(FrameInfo& frameInfo);
+  void writeLights(FrameInfo& frameInfo, GlobalUbo& ubo);
   void render(FrameInfo& frameInfo);
 
+  // rebuilds the pipeline in the background if it was created from the SPIR-V file at filepath
+  void reloadShader(const std::string& filepath, VkRenderPass renderPass);
+
 private:
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 
-  void createPipeline(VkRenderPass renderPass);
+  std::unique_ptr<LvePipeline> createPipeline(VkRenderPass renderPass) const;
 
   LveDevice& lveDevice;
 
   std::unique_ptr<LvePipeline> lvePipeline;
   VkPipelineLayout pipelineLayout;
+  LvePipelineReloader pipelineReloader;
 };
 } // namespace lve
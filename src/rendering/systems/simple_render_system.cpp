@@ -1,6 +1,8 @@
 #include "simple_render_system.h"
 #include "glm/gtc/constants.hpp"
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <stdexcept>
 
 #define GLM_FORCE_RADIANS
@@ -9,18 +11,28 @@
 #include "glm/glm.hpp"
 
 namespace lve {
+// 116 bytes, within the 128 every device supports
 struct SimplePushConstantData {
+  // dequantizes packed positions before the model transform
   glm::mat4 modelMatrix{1.0f};
+  // mat3 columns are padded to 16 bytes in the shader
+  glm::vec4 normalMatrix[3]{};
+  // 1 for octahedral encoded normals
+  uint32_t octahedralNormals = 0;
 };
 
-SimpleRenderSystem::SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass,
+SimpleRenderSystem::SimpleRenderSystem(LveDevice& device, LveThreadPool& threadPool,
+                                       VkRenderPass renderPass,
                                        VkDescriptorSetLayout globalSetLayout)
-    : lveDevice{device} {
+    : lveDevice{device}, pipelineReloader{device, threadPool}, meshletCullSystem{device,
+                                                                                 threadPool} {
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  createPipeline(renderPass, lvePipeline, packedPipeline);
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
+  // a reload may still be building with the layout
+  pipelineReloader.wait();
   vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -44,36 +56,172 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
   }
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+// runs on worker threads for reloads
+void SimpleRenderSystem::createPipeline(VkRenderPass renderPass,
+                                        std::unique_ptr<LvePipeline>& pipeline,
+                                        std::unique_ptr<LvePipeline>& packed) const {
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
   LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(lveDevice, "./shaders/simple_shader.vert.spv",
-                                              "./shaders/simple_shader.frag.spv", pipelineConfig);
+  pipeline = std::make_unique<LvePipeline>(lveDevice, "./shaders/simple_shader.vert.spv",
+                                           "./shaders/simple_shader.frag.spv", pipelineConfig);
+
+  // same shaders, only the vertex input differs
+  pipelineConfig.bindingDescriptions = LveModel::PackedVertex::getBindingDescription();
+  pipelineConfig.attributeDescriptions = LveModel::PackedVertex::getAttributeDescription();
+  packed = std::make_unique<LvePipeline>(lveDevice, "./shaders/simple_shader.vert.spv",
+                                         "./shaders/simple_shader.frag.spv", pipelineConfig);
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-  lvePipeline->bind(frameInfo.commandBuffer);
+// both pipelines share their shaders and are rebuilt together
+void SimpleRenderSystem::reloadShader(const std::string& filepath, VkRenderPass renderPass) {
+  meshletCullSystem.reloadShader(filepath);
+  if (!lvePipeline->usesShader(filepath)) {
+    return;
+  }
 
-  vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
-                          0, 1, &frameInfo.globalDescriptorSet, 0, nullptr);
+  pipelineReloader.reload(filepath, [this, renderPass]() {
+    LvePipelineReloader::Pipelines pipelines(2);
+    createPipeline(renderPass, pipelines[0], pipelines[1]);
+    return pipelines;
+  });
+}
+
+void SimpleRenderSystem::cullGameObjects(FrameInfo& frameInfo) {
+  pipelineReloader.swap({&lvePipeline, &packedPipeline});
+  submeshDraws.clear();
+  meshletCullSystem.begin();
+  auto& scene = frameInfo.scene;
+  auto& models = scene.models.components();
+  const auto& ids = scene.models.ids();
+  for (size_t i = 0; i < models.size(); i++) {
+    LveModel* model = models[i].getModel();
+    if (model == nullptr || !model->isResident()) {
+      continue;
+    }
 
-  for (auto& [id, obj] : frameInfo.gameObjects) {
-    if (obj.model == nullptr) {
+    const auto& transform = scene.transforms().get(ids[i]);
+    const glm::mat4& modelMatrix = transform.worldMatrix;
+    uint32_t lod = 0;
+    if (!selectLod(frameInfo, *model, modelMatrix, lod)) {
       continue;
     }
 
+    const auto& level = model->getLods()[lod];
+    for (uint32_t s = 0; s < level.submeshCount; s++) {
+      const auto& submesh = model->getSubmeshes()[level.firstSubmesh + s];
+      const auto& submeshNormalMatrix =
+          model->getSubmeshNormalMatrices()[level.firstSubmesh + s];
+      SubmeshDraw draw{model,
+                       &submesh,
+                       modelMatrix * submesh.transform,
+                       transform.worldNormalMatrix * submeshNormalMatrix,
+                       false,
+                       {}};
+      draw.indirect =
+          meshletCullSystem.cull(frameInfo, *model, submesh, draw.modelMatrix, draw.draws);
+      submeshDraws.push_back(draw);
+    }
+  }
+  meshletCullSystem.end(frameInfo);
+
+  // models of the same vertex format and index type share their buffers, grouping them keeps
+  // rebinding to a handful of times per frame. Submeshes of one model stay next to each other
+  std::stable_sort(submeshDraws.begin(), submeshDraws.end(),
+                   [](const SubmeshDraw& a, const SubmeshDraw& b) {
+                     if (a.model->getVertexFormat() != b.model->getVertexFormat()) {
+                       return a.model->getVertexFormat() < b.model->getVertexFormat();
+                     }
+                     return a.model->getIndexType() < b.model->getIndexType();
+                   });
+}
+
+void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+  vkCmdBindDescriptorSets(frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                          0, 1, &frameInfo.globalDescriptorSet, 1, &frameInfo.globalUboOffset);
+
+  // the pipelines share their layout, so the descriptor set stays bound when switching
+  LvePipeline* boundPipeline = nullptr;
+  const LveModel* boundModel = nullptr;
+  for (const auto& draw : submeshDraws) {
+    bool packed = draw.model->getVertexFormat() == LveModel::VertexFormat::Packed;
+    LvePipeline* pipeline = packed ? packedPipeline.get() : lvePipeline.get();
+    if (pipeline != boundPipeline) {
+      pipeline->bind(frameInfo.commandBuffer);
+      boundPipeline = pipeline;
+    }
+    // draws select their model through firstIndex and vertexOffset within the bound buffers
+    if (boundModel == nullptr || draw.model->getVertexFormat() != boundModel->getVertexFormat() ||
+        draw.model->getIndexType() != boundModel->getIndexType()) {
+      draw.model->bind(frameInfo.commandBuffer);
+      boundModel = draw.model;
+    }
+
     SimplePushConstantData push{};
-    push.modelMatrix = obj.transform.mat4();
+    push.modelMatrix =
+        glm::scale(glm::translate(draw.modelMatrix, draw.model->getPositionOffset()),
+                   draw.model->getPositionScale());
+    for (int column = 0; column < 3; column++) {
+      push.normalMatrix[column] = glm::vec4(draw.normalMatrix[column], 0.f);
+    }
+    push.octahedralNormals = packed ? 1 : 0;
 
     vkCmdPushConstants(frameInfo.commandBuffer, pipelineLayout,
                        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                        sizeof(SimplePushConstantData), &push);
-    obj.model->bind(frameInfo.commandBuffer);
-    obj.model->draw(frameInfo.commandBuffer);
+    if (draw.indirect) {
+      meshletCullSystem.draw(frameInfo, draw.draws);
+    } else {
+      draw.model->drawSubmesh(frameInfo.commandBuffer, *draw.submesh);
+    }
+  }
+}
+
+/**
+ * Picks the coarsest level of detail whose error stays below lodErrorPixels on screen. Sizes are
+ * projected at the point of the bounding sphere closest to the camera, so the estimate errs
+ * towards finer levels
+ *
+ * @return false if the object is too small on screen to be drawn
+ */
+bool SimpleRenderSystem::selectLod(const FrameInfo& frameInfo, const LveModel& model,
+                                   const glm::mat4& modelMatrix, uint32_t& lod) const {
+  lod = 0;
+
+  // submesh transforms are assumed not to scale, only the object's scale is applied to errors
+  float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+                         glm::max(glm::length(glm::vec3(modelMatrix[1])),
+                                  glm::length(glm::vec3(modelMatrix[2]))));
+  glm::vec3 center = (model.getBoundsMin() + model.getBoundsMax()) * 0.5f;
+  float radius = glm::length(model.getBoundsMax() - model.getBoundsMin()) * 0.5f * scale;
+
+  const glm::mat4& projection = frameInfo.camera.getProjection();
+  float pixelsPerUnit =
+      std::abs(projection[1][1]) * 0.5f * static_cast<float>(frameInfo.extent.height);
+  // perspective projections divide by the view depth
+  if (projection[2][3] != 0.f) {
+    glm::vec4 viewCenter = frameInfo.camera.getView() * modelMatrix * glm::vec4(center, 1.f);
+    float distance = viewCenter.z - radius;
+    if (distance <= 0.f) {
+      return true;
+    }
+    pixelsPerUnit /= distance;
+  }
+
+  if (radius * pixelsPerUnit < lodCullPixels) {
+    return false;
+  }
+
+  const auto& lods = model.getLods();
+  for (uint32_t i = 1; i < lods.size(); i++) {
+    if (lods[i].error * scale * pixelsPerUnit > lodErrorPixels) {
+      break;
+    }
+    lod = i;
   }
+  return true;
 }
 } // namespace lve
@@ -5,14 +5,17 @@
 #include "../../lve_model.h"
 #include "../lve_frame_info.h"
 #include "../lve_pipeline.h"
+#include "../lve_pipeline_reloader.h"
 #include "../lve_renderer.h"
 #include "../lve_window.h"
+#include "meshlet_cull_system.h"
 #include <memory>
+#include <vector>
 
 namespace lve {
 class SimpleRenderSystem {
 public:
-  SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass,
+  SimpleRenderSystem(LveDevice& device, LveThreadPool& threadPool, VkRenderPass renderPass,
                      VkDescriptorSetLayout globalSetLayout);
 
   ~SimpleRenderSystem();
@@ -20,16 +23,55 @@ public:
   SimpleRenderSystem(const SimpleRenderSystem&) = delete;
   SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+  // selects levels of detail and culls meshlets on the GPU, has to be recorded outside of the
+  // render pass before renderGameObjects. Swaps in pipelines reloaded since the last frame
+  void cullGameObjects(FrameInfo& frameInfo);
+
+  // draws what the last cullGameObjects kept
   void renderGameObjects(FrameInfo& frameInfo);
 
+  // rebuilds the pipelines created from the SPIR-V file at filepath in the background
+  void reloadShader(const std::string& filepath, VkRenderPass renderPass);
+
+  // maxErrorPixels is how far, in pixels, a level of detail may deviate from the full model on
+  // screen. Objects whose bounding sphere has a smaller radius than cullPixels aren't drawn
+  void setLodThresholds(float maxErrorPixels, float cullPixels) {
+    lodErrorPixels = maxErrorPixels;
+    lodCullPixels = cullPixels;
+  }
+
 private:
+  // a submesh to draw, either through the indirect draws written by meshletCullSystem or directly
+  struct SubmeshDraw {
+    const LveModel* model;
+    const LveModel::Submesh* submesh;
+    glm::mat4 modelMatrix;
+    // inverse transpose of modelMatrix' upper 3x3
+    glm::mat3 normalMatrix;
+    bool indirect;
+    MeshletCullSystem::DrawRange draws;
+  };
+
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 
-  void createPipeline(VkRenderPass renderPass);
+  void createPipeline(VkRenderPass renderPass, std::unique_ptr<LvePipeline>& pipeline,
+                      std::unique_ptr<LvePipeline>& packed) const;
+
+  bool selectLod(const FrameInfo& frameInfo, const LveModel& model, const glm::mat4& modelMatrix,
+                 uint32_t& lod) const;
 
   LveDevice& lveDevice;
 
   std::unique_ptr<LvePipeline> lvePipeline;
+  // for models with LveModel::VertexFormat::Packed
+  std::unique_ptr<LvePipeline> packedPipeline;
   VkPipelineLayout pipelineLayout;
+  LvePipelineReloader pipelineReloader;
+
+  MeshletCullSystem meshletCullSystem;
+  std::vector<SubmeshDraw> submeshDraws{};
+
+  float lodErrorPixels = 1.f;
+  float lodCullPixels = 1.f;
 };
 } // namespace lve
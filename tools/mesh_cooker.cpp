@@ -0,0 +1,63 @@
+#include "lve_mesh_file.h"
+#include "lve_model.h"
+
+#include <fmt/core.h>
+
+// std
+#include <exception>
+#include <filesystem>
+#include <set>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Cooks every model in a source directory into <output directory>/<file name>.lvemesh, skipping
+// models whose cooked file is still up to date
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fmt::println("usage: {} <asset directory> <output directory>", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const fs::path sourceDir{argv[1]};
+  const fs::path outputDir{argv[2]};
+  const std::set<std::string> modelExtensions{".obj", ".gltf", ".glb", ".fbx"};
+
+  fs::create_directories(outputDir);
+
+  int failed = 0;
+  for (const auto& entry : fs::directory_iterator(sourceDir)) {
+    if (!entry.is_regular_file() || modelExtensions.count(entry.path().extension().string()) == 0) {
+      continue;
+    }
+
+    const std::string sourcePath = entry.path().string();
+    const std::string cookedPath =
+        lve::LveMeshFile::cookedPathFor((outputDir / entry.path().filename()).string());
+
+    lve::LveMeshFile existing{};
+    if (existing.open(cookedPath, sourcePath)) {
+      fmt::println("{}: up to date", cookedPath);
+      continue;
+    }
+
+    try {
+      uint64_t sourceSize = 0;
+      int64_t sourceModifiedTime = 0;
+      lve::LveMeshFile::statSource(sourcePath, sourceSize, sourceModifiedTime);
+
+      lve::LveModel::Builder builder{};
+      builder.loadModel(sourcePath);
+      lve::LveMeshFile::write(cookedPath, builder, sourceSize, sourceModifiedTime);
+
+      fmt::println("{}: {} vertices, {} indices, {} submeshes, {} lods, {} meshlets", cookedPath,
+                   builder.vertices.size(), builder.indices.size(), builder.submeshes.size(),
+                   builder.lods.size(), builder.meshlets.size());
+    } catch (const std::exception& e) {
+      fmt::println("{}: {}", sourcePath, e.what());
+      failed++;
+    }
+  }
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+#include "lve_game_object.h"
+#include "lve_transform_batch.h"
+
+#include <fmt/core.h>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+using lve::LveTransformBatch;
+
+namespace {
+// best of several runs, in nanoseconds per transform
+double measure(size_t count, int runs, const std::function<void()>& body) {
+  double best = std::numeric_limits<double>::max();
+  for (int run = 0; run < runs; run++) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / static_cast<double>(count));
+  }
+  return best;
+}
+
+float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+  float difference = 0.f;
+  for (size_t i = 0; i < a.size(); i++) {
+    for (int column = 0; column < 4; column++) {
+      for (int row = 0; row < 4; row++) {
+        difference = std::max(difference, std::abs(a[i][column][row] - b[i][column][row]));
+      }
+    }
+  }
+  return difference;
+}
+} // namespace
+
+// Compares TransformComponent::mat4, called once per object, with LveTransformBatch::compose and
+// composeQuaternions on every instruction set the CPU supports
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  int runs = argc > 2 ? std::atoi(argv[2]) : 20;
+  if (count == 0 || runs <= 0) {
+    fmt::println("usage: {} [transform count] [runs]", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 random{42};
+  std::uniform_real_distribution<float> position{-100.f, 100.f};
+  std::uniform_real_distribution<float> angle{-glm::pi<float>(), glm::pi<float>()};
+  std::uniform_real_distribution<float> scale{.1f, 10.f};
+
+  std::vector<lve::TransformComponent> transforms(count);
+  std::vector<lve::TransformComponent> quaternionTransforms(count);
+  std::vector<float> arrays[13];
+  for (auto& array : arrays) {
+    array.resize(count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    auto& transform = transforms[i];
+    for (int axis = 0; axis < 3; axis++) {
+      transform.translation[axis] = arrays[axis][i] = position(random);
+      transform.rotation[axis] = arrays[3 + axis][i] = angle(random);
+      transform.scale[axis] = arrays[6 + axis][i] = scale(random);
+    }
+
+    auto& quaternionTransform = quaternionTransforms[i] = transform;
+    quaternionTransform.rotationMode = lve::TransformComponent::RotationMode::Quaternion;
+    quaternionTransform.orientation = glm::quat{transform.rotation};
+    arrays[9][i] = quaternionTransform.orientation.x;
+    arrays[10][i] = quaternionTransform.orientation.y;
+    arrays[11][i] = quaternionTransform.orientation.z;
+    arrays[12][i] = quaternionTransform.orientation.w;
+  }
+
+  LveTransformBatch::Input input{
+      {arrays[0].data(), arrays[1].data(), arrays[2].data()},
+      {arrays[3].data(), arrays[4].data(), arrays[5].data()},
+      {arrays[6].data(), arrays[7].data(), arrays[8].data()},
+      {arrays[9].data(), arrays[10].data(), arrays[11].data(), arrays[12].data()}};
+
+  std::vector<glm::mat4> reference(count);
+  double perObject = measure(count, runs, [&]() {
+    for (size_t i = 0; i < count; i++) {
+      reference[i] = transforms[i].mat4();
+    }
+  });
+  fmt::println("{} transforms, best of {} runs", count, runs);
+  fmt::println("{:>22}: {:6.2f} ns/transform", "TransformComponent", perObject);
+
+  std::vector<glm::mat4> quaternionReference(count);
+  double perQuaternionObject = measure(count, runs, [&]() {
+    for (size_t i = 0; i < count; i++) {
+      quaternionReference[i] = quaternionTransforms[i].mat4();
+    }
+  });
+  fmt::println("{:>22}: {:6.2f} ns/transform", "quaternion transform", perQuaternionObject);
+
+  std::vector<glm::mat4> models(count);
+  std::vector<glm::mat4> normals(count);
+  for (auto isa : {LveTransformBatch::Isa::Scalar, LveTransformBatch::Isa::Sse2,
+                   LveTransformBatch::Isa::Avx2}) {
+    if (isa > LveTransformBatch::getSupportedIsa()) {
+      break;
+    }
+    LveTransformBatch::setIsa(isa);
+
+    double batch = measure(count, runs, [&]() {
+      LveTransformBatch::compose(input, count, models.data());
+    });
+    double withNormals = measure(count, runs, [&]() {
+      LveTransformBatch::compose(input, count, models.data(), normals.data());
+    });
+    fmt::println("{:>22}: {:6.2f} ns/transform ({:.1f}x), {:6.2f} with normal matrices, max "
+                 "difference {:.2g}",
+                 fmt::format("batch {}", LveTransformBatch::isaName(isa)), batch,
+                 perObject / batch, withNormals, maxDifference(reference, models));
+
+    double quaternions = measure(count, runs, [&]() {
+      LveTransformBatch::composeQuaternions(input, count, models.data(), normals.data());
+    });
+    fmt::println("{:>22}: {:6.2f} ns/transform with normal matrices, max difference {:.2g}",
+                 fmt::format("quaternions {}", LveTransformBatch::isaName(isa)), quaternions,
+                 maxDifference(quaternionReference, models));
+  }
+
+  return EXIT_SUCCESS;
+}